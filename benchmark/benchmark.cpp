@@ -0,0 +1,263 @@
+// benchmark.cpp
+//
+// Parser regression benchmark. Build in release mode and run without
+// arguments. The first table checks that path operands are consumed in
+// linear time; the process exits with 1 if that case stops scaling. The
+// second times parseSvg, getSvgPointList and getSvgImage separately over
+// generated documents that grow along one axis at a time.
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <cstdio>
+
+#include "../svghelper.hpp"
+
+namespace {
+
+const int kRepeats = 5;
+const int kSuiteRepeats = 3;
+// Allowed growth of the per-operand cost between the smallest and the
+// largest run before the case is reported as super-linear
+const double kMaxCostRatio = 4.0;
+
+// A single "l" followed by pairCount implicit coordinate pairs, the shape
+// digitizer exports produce
+QByteArray implicitLineRun(int pairCount) {
+  QByteArray d = "M0 0l";
+  d.reserve(pairCount * 6 + 8);
+  for (int i = 0; i < pairCount; ++i) {
+    d += (i % 2) ? "1 -1 " : "1 1 ";
+  }
+  return "<svg xmlns=\"http://www.w3.org/2000/svg\"><path d=\"" + d +
+         "\"/></svg>";
+}
+
+// Shape of a generated document. Each axis scales on its own; the others
+// stay at these defaults.
+struct DocumentShape {
+  int elements = 2000;      // <path> elements
+  int commandsPerPath = 8;  // Commands in each d attribute
+  int runLength = 1;        // Coordinate groups per command letter
+  int arcPercent = 0;       // Share of commands that are arcs
+  int depth = 0;            // <g> elements around each path
+};
+
+// Deterministic coordinates, so every run parses the same document
+class Coordinates {
+ public:
+  int next() {
+    state = state * 1103515245u + 12345u;
+    return int((state >> 16) % 200) - 100;
+  }
+
+ private:
+  quint32 state = 1;
+};
+
+QByteArray generateDocument(const DocumentShape& shape) {
+  Coordinates random;
+  QByteArray svg =
+      "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"1000\" "
+      "height=\"1000\" viewBox=\"-500 -500 1000 1000\">\n";
+  for (int e = 0; e < shape.elements; ++e) {
+    for (int g = 0; g < shape.depth; ++g) {
+      svg += "<g>";
+    }
+    svg += "<path d=\"M" + QByteArray::number(random.next()) + ' ' +
+           QByteArray::number(random.next());
+    for (int c = 0; c < shape.commandsPerPath; ++c) {
+      // Spread the arcs evenly over all commands of the document, so each
+      // path mixes them with the rest instead of being all arcs or none
+      const qint64 index = qint64(e) * shape.commandsPerPath + c;
+      const bool arc = (index + 1) * shape.arcPercent / 100 >
+                       index * shape.arcPercent / 100;
+      // Alternate lines and cubic curves so sampling has work to do
+      const char letter = arc ? 'a' : (c % 2 ? 'c' : 'l');
+      const int operands = arc ? 7 : (letter == 'c' ? 6 : 2);
+      svg += ' ';
+      svg += letter;
+      for (int r = 0; r < shape.runLength; ++r) {
+        for (int o = 0; o < operands; ++o) {
+          int value = random.next();
+          if (arc && o < 2) {
+            value = qAbs(value) + 10;  // Radii
+          } else if (arc && (o == 3 || o == 4)) {
+            value = value > 0;  // Large-arc and sweep flags
+          }
+          svg += ' ' + QByteArray::number(value);
+        }
+      }
+    }
+    svg += "\"/>";
+    for (int g = 0; g < shape.depth; ++g) {
+      svg += "</g>";
+    }
+    svg += '\n';
+  }
+  return svg + "</svg>\n";
+}
+
+bool writeFile(const QString& filepath, const QByteArray& content) {
+  QFile file(filepath);
+  if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+    return false;
+  }
+  return file.write(content) == content.size();
+}
+
+// Best of kRepeats runs, in nanoseconds
+qint64 timeParse(const QString& filepath) {
+  qint64 best = -1;
+  for (int i = 0; i < kRepeats; ++i) {
+    SvgHelper helper;
+    QElapsedTimer timer;
+    timer.start();
+    helper.parseSvg(filepath);
+    const qint64 elapsed = timer.nsecsElapsed();
+    if (best < 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best;
+}
+
+// Best of kSuiteRepeats fresh runs of step, which returns its own time in
+// nanoseconds so setup stays out of the measurement
+template <typename Step>
+qint64 bestOf(Step step) {
+  qint64 best = -1;
+  for (int i = 0; i < kSuiteRepeats; ++i) {
+    const qint64 elapsed = step();
+    if (best < 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best;
+}
+
+struct SuiteCase {
+  const char* axis;
+  int value;
+  DocumentShape shape;
+};
+
+QVector<SuiteCase> suiteCases() {
+  QVector<SuiteCase> cases;
+  for (int elements : {1000, 10000, 100000}) {
+    DocumentShape shape;
+    shape.elements = elements;
+    cases.append({"elements", elements, shape});
+  }
+  for (int commands : {2, 32, 512}) {
+    DocumentShape shape;
+    shape.commandsPerPath = commands;
+    cases.append({"commands/path", commands, shape});
+  }
+  for (int run : {1, 16, 256}) {
+    DocumentShape shape;
+    shape.runLength = run;
+    cases.append({"run length", run, shape});
+  }
+  for (int percent : {0, 50, 100}) {
+    DocumentShape shape;
+    shape.arcPercent = percent;
+    cases.append({"arc %", percent, shape});
+  }
+  for (int depth : {0, 16, 128}) {
+    DocumentShape shape;
+    shape.depth = depth;
+    cases.append({"nesting depth", depth, shape});
+  }
+  return cases;
+}
+
+// Throughput per axis. parse uses the default outputs (paths and points);
+// points is the lazy getSvgPointList() after a PathOutput-only parse;
+// image is getSvgImage() at the document's 1000x1000 size.
+bool runSuite(const QString& filepath) {
+  std::printf("\n%-14s %7s %8s %8s %10s %9s %12s %10s %10s\n", "axis",
+              "value", "MB", "elements", "parse ms", "MB/s", "elements/s",
+              "points ms", "image ms");
+  for (const SuiteCase& suiteCase : suiteCases()) {
+    const QByteArray content = generateDocument(suiteCase.shape);
+    if (!writeFile(filepath, content)) {
+      std::fprintf(stderr, "Failed to write %s\n", qPrintable(filepath));
+      return false;
+    }
+
+    const qint64 parse = bestOf([&] {
+      SvgHelper helper;
+      QElapsedTimer timer;
+      timer.start();
+      helper.parseSvg(filepath);
+      return timer.nsecsElapsed();
+    });
+    const qint64 points = bestOf([&] {
+      SvgHelper helper;
+      helper.setParseOutputs(SvgHelper::PathOutput);
+      helper.parseSvg(filepath);
+      QElapsedTimer timer;
+      timer.start();
+      helper.getSvgPointList();
+      return timer.nsecsElapsed();
+    });
+    SvgHelper rendered;
+    rendered.setParseOutputs(SvgHelper::PathOutput);
+    rendered.parseSvg(filepath);
+    const qint64 image = bestOf([&] {
+      QElapsedTimer timer;
+      timer.start();
+      rendered.getSvgImage();
+      return timer.nsecsElapsed();
+    });
+
+    const double megabytes = content.size() / 1e6;
+    const double seconds = parse / 1e9;
+    std::printf("%-14s %7d %8.2f %8d %10.2f %9.1f %12.0f %10.2f %10.2f\n",
+                suiteCase.axis, suiteCase.value, megabytes,
+                suiteCase.shape.elements, parse / 1e6, megabytes / seconds,
+                suiteCase.shape.elements / seconds, points / 1e6,
+                image / 1e6);
+  }
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  const QString filepath = QDir::temp().filePath("svghelper_benchmark.svg");
+  const int pairCounts[] = {1000, 10000, 100000};
+
+  std::printf("%-20s %10s %12s %12s\n", "case", "operands", "ms",
+              "ns/operand");
+  double firstCost = 0;
+  double lastCost = 0;
+  for (int pairCount : pairCounts) {
+    if (!writeFile(filepath, implicitLineRun(pairCount))) {
+      std::fprintf(stderr, "Failed to write %s\n", qPrintable(filepath));
+      return 2;
+    }
+    const int operands = pairCount * 2;
+    const qint64 elapsed = timeParse(filepath);
+    const double cost = static_cast<double>(elapsed) / operands;
+    std::printf("%-20s %10d %12.3f %12.1f\n", "implicit l run", operands,
+                elapsed / 1e6, cost);
+    if (firstCost == 0) {
+      firstCost = cost;
+    }
+    lastCost = cost;
+  }
+
+  const double ratio = lastCost / firstCost;
+  std::printf("per-operand cost ratio (largest/smallest): %.2f\n", ratio);
+
+  const bool suiteRan = runSuite(filepath);
+  QFile::remove(filepath);
+  if (ratio > kMaxCostRatio) {
+    std::printf("FAIL: path operand consumption is not linear\n");
+    return 1;
+  }
+  return suiteRan ? 0 : 2;
+}
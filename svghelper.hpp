@@ -3,190 +3,3337 @@
 #ifndef SVGHELPER_HPP
 #define SVGHELPER_HPP
 
+#include <QBuffer>
 #include <QChar>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDeadlineTimer>
 #include <QDebug>
+#include <QDir>
 #include <QDomDocument>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QFileInfo>
+#include <QHash>
 #include <QImage>
 #include <QList>
+#include <QLocale>
 #include <QPainter>
 #include <QPainterPath>
+#include <QPair>
 #include <QPointF>
 #include <QRect>
 #include <QRectF>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QSet>
 #include <QSize>
 #include <QString>
-#include <QSvgRenderer>
+#include <QStringList>
+#include <QThread>
+#include <QTransform>
+#include <QThreadPool>
 #include <QVector>
 #include <QXmlStreamReader>
 #include <QtMath>  // For qRadiansToDegrees
 #include <QtXml>
-#include <cmath>  // For M_PI, sqrt, abs, atan2, acos
+#include <algorithm>  // For std::sort, std::unique
+#include <atomic>
+#include <charconv>  // For std::from_chars
+#include <cmath>     // For M_PI, sqrt, abs, atan2, acos
+#include <cstring>   // For memcmp, memcpy, memset
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>  // For std::call_once
+
+// Points of one shape in a flat point store. Non-owning, like
+// SvgPointsView it comes from.
+template <typename Real>
+class SvgShapePoints {
+ public:
+  SvgShapePoints(const Real* xs, const Real* ys, int count)
+      : xs(xs), ys(ys), count(count) {}
+
+  int size() const { return count; }
+  bool isEmpty() const { return count == 0; }
+  Real x(int i) const { return xs[i]; }
+  Real y(int i) const { return ys[i]; }
+  QPointF at(int i) const { return QPointF(xs[i], ys[i]); }
+  const Real* xData() const { return xs; }
+  const Real* yData() const { return ys; }
+
+ private:
+  const Real* xs;
+  const Real* ys;
+  int count;
+};
+
+// Non-owning view of flat point storage: the x and y coordinates of all
+// shapes back to back in two arrays, shape i at [offsets[i], offsets[i + 1]).
+// Iterating the shapes allocates nothing.
+template <typename Real>
+class SvgPointsView {
+ public:
+  class ShapeIterator {
+   public:
+    ShapeIterator(const SvgPointsView* view, int index)
+        : view(view), index(index) {}
+
+    SvgShapePoints<Real> operator*() const { return view->shape(index); }
+    ShapeIterator& operator++() {
+      ++index;
+      return *this;
+    }
+    bool operator!=(const ShapeIterator& other) const {
+      return index != other.index;
+    }
+
+   private:
+    const SvgPointsView* view;
+    int index;
+  };
+
+  SvgPointsView() = default;
+  SvgPointsView(const Real* xs, const Real* ys, const int* offsets,
+                int shapeCount)
+      : xs(xs), ys(ys), offsets(offsets), shapes(shapeCount) {}
+
+  int shapeCount() const { return shapes; }
+  int pointCount() const { return shapes > 0 ? offsets[shapes] : 0; }
+  SvgShapePoints<Real> shape(int i) const {
+    return SvgShapePoints<Real>(xs + offsets[i], ys + offsets[i],
+                                offsets[i + 1] - offsets[i]);
+  }
+  const Real* xData() const { return xs; }
+  const Real* yData() const { return ys; }
+  const int* offsetData() const { return offsets; }  // shapeCount() + 1
+
+  ShapeIterator begin() const { return ShapeIterator(this, 0); }
+  ShapeIterator end() const { return ShapeIterator(this, shapes); }
+
+ private:
+  const Real* xs = nullptr;
+  const Real* ys = nullptr;
+  const int* offsets = nullptr;
+  int shapes = 0;
+};
+
+// Owning flat point storage, one allocation per coordinate array instead of
+// one QList per shape
+template <typename Real>
+class SvgPointStore {
+ public:
+  SvgPointStore() : offsets(1, 0) {}
+
+  void appendShape(const QList<QPointF>& points) {
+    for (const QPointF& point : points) {
+      xs.append(Real(point.x()));
+      ys.append(Real(point.y()));
+    }
+    offsets.append(int(xs.size()));
+  }
+
+  // Appends points mapped through transform. The new coordinates are
+  // mapped in one pass over the x and y arrays, which are contiguous, so
+  // the loop vectorizes whatever the QList layout.
+  void appendShape(const QList<QPointF>& points, const QTransform& transform) {
+    const int first = int(xs.size());
+    appendShape(points);
+    if (transform.isIdentity()) {
+      return;
+    }
+    const int count = int(xs.size()) - first;
+    Real* x = xs.data() + first;
+    Real* y = ys.data() + first;
+    const qreal m11 = transform.m11();
+    const qreal m12 = transform.m12();
+    const qreal m21 = transform.m21();
+    const qreal m22 = transform.m22();
+    const qreal dx = transform.dx();
+    const qreal dy = transform.dy();
+    for (int i = 0; i < count; ++i) {
+      const qreal px = x[i];
+      const qreal py = y[i];
+      x[i] = Real(m11 * px + m21 * py + dx);
+      y[i] = Real(m12 * px + m22 * py + dy);
+    }
+  }
+
+  template <typename Source>
+  void appendShape(const SvgShapePoints<Source>& points) {
+    for (int i = 0; i < points.size(); ++i) {
+      xs.append(Real(points.x(i)));
+      ys.append(Real(points.y(i)));
+    }
+    offsets.append(int(xs.size()));
+  }
+
+  void append(const SvgPointStore& other) {
+    const int base = int(xs.size());
+    xs += other.xs;
+    ys += other.ys;
+    for (int i = 1; i < other.offsets.size(); ++i) {
+      offsets.append(base + other.offsets.at(i));
+    }
+  }
+
+  void squeeze() {
+    xs.squeeze();
+    ys.squeeze();
+    offsets.squeeze();
+  }
+
+  SvgPointsView<Real> view() const {
+    return SvgPointsView<Real>(xs.constData(), ys.constData(),
+                               offsets.constData(), int(offsets.size()) - 1);
+  }
+
+ private:
+  QVector<Real> xs;
+  QVector<Real> ys;
+  QVector<int> offsets;
+};
+
+// Stops a running parse from any thread. Copies share the same state, so
+// keep one and hand a copy to SvgHelper::setCancelToken().
+class SvgCancelToken {
+ public:
+  SvgCancelToken() : canceled(std::make_shared<std::atomic<bool>>(false)) {}
+
+  void cancel() const { *canceled = true; }
+  void reset() const { *canceled = false; }
+  bool isCanceled() const { return *canceled; }
+
+ private:
+  std::shared_ptr<std::atomic<bool>> canceled;
+};
+
+// Where a parse spent its time and what it found; see
+// SvgHelper::setCollectStats(). Times are in nanoseconds. With parallel
+// parsing the tokenize and geometry times are summed over the threads.
+struct SvgParseStats {
+  qint64 totalNs = 0;     // Whole parse, wall time
+  qint64 documentNs = 0;  // Reading the input and walking the XML or DOM
+  qint64 tokenizeNs = 0;  // Numbers of d and points attributes
+  qint64 geometryNs = 0;  // Building paths and sampling points
+  qint64 renderNs = 0;    // Last renderSvgImage() or getSvgImage()
+  bool cacheHit = false;  // Loaded from the binary cache, nothing parsed
+  qint64 bytesRead = -1;  // -1 for sequential devices
+  qint64 pointCount = 0;  // Sampled points of all shapes
+  int shapeCount = 0;
+  QHash<QString, int> elementCounts;  // Shape elements by tag name
+  QHash<QChar, int> commandCounts;    // Path commands by letter, as written
+};
+
+// A shape drawn by a <use> element: shared geometry from the symbol lists
+// and where it goes. See SvgHelper::setResolveUses().
+struct SvgInstance {
+  int shape;             // Index into the document's symbol lists
+  QTransform transform;  // From the symbol's coordinates to the results'
+  int index;             // Index of the drawn shape in the flat lists
+};
+
+// Result of one parse: the paths and point lists of every shape, in document
+// order. Nothing changes after parsing and copies share the same data, so a
+// document can be cached or handed to another thread without copying.
+class SvgDocument {
+ public:
+  enum ParseStatus {
+    Complete,  // The whole input was parsed
+    Canceled,  // Stopped by a SvgCancelToken
+    TimedOut,  // Stopped by SvgHelper::setTimeLimit()
+  };
+
+  SvgDocument();
+
+  // When parsing stopped early the lists hold the shapes of the elements
+  // before that point, in document order
+  ParseStatus getParseStatus() const;
+  // Empty unless the parse collected them
+  SvgParseStats getParseStats() const;
+
+  QString getFilepath() const;
+  const QList<QPainterPath>& getSvgPathList() const;
+  // Safe to call from several threads, including the first call that
+  // flattens the paths when only PathOutput was parsed
+  const QList<QList<QPointF>>& getSvgPointList() const;
+  // Filled with FlatPointOutput, in qreal or (with FloatPoints) float
+  SvgPointsView<qreal> getFlatPointList() const;
+  SvgPointsView<float> getFlatPointListF() const;
+
+  // Size of the root <svg> element (width/height, else the viewBox size)
+  // and its viewBox, read while parsing. Invalid when the file has none.
+  QSize getSize() const;
+  QRectF getViewBox() const;
+
+  // boundingRect() of every path, index-aligned with getSvgPathList().
+  // Computed once on first use; safe to call from several threads.
+  const QVector<QRectF>& getPathBounds() const;
+
+  // Spatial queries over the path bounds, backed by a uniform grid that is
+  // built on first use (or by parseSvg, see setBuildSpatialIndex()).
+  // pathsInRect() returns the indexes of the paths whose bounds intersect
+  // rect, ascending. nearestPath() returns the path whose outline (its
+  // point list) is closest to point, or -1 if none is within maxDistance.
+  QVector<int> pathsInRect(const QRectF& rect) const;
+  int nearestPath(const QPointF& point, qreal maxDistance = -1) const;
+
+  // With SvgHelper::setResolveUses(): the shapes inside <defs> and
+  // <symbol>, parsed once in their own coordinates, and one SvgInstance
+  // per shape drawn through a <use>, in document order. The lists above
+  // include the instances, but they are only expanded into them on the
+  // first call that needs them; reading these three never does.
+  const QList<QPainterPath>& getSymbolPathList() const;
+  const QList<QList<QPointF>>& getSymbolPointList() const;
+  const QVector<SvgInstance>& getInstances() const;
+
+ private:
+  friend class SvgHelper;
+  struct Data;
+
+  void ensureSpatialIndex() const;
+  void ensureInstances() const;
+
+  // std::shared_ptr rather than QSharedPointer for use_count(), which lets
+  // SvgHelper::takeResults() move out of a document nobody else holds
+  std::shared_ptr<const Data> d;
+};
+
+// Receives every shape while the document is being parsed, in document
+// order, as soon as its element is done. See SvgHelper::setShapeVisitor().
+class SvgShapeVisitor {
+ public:
+  struct ElementInfo {
+    QString tagname;
+    QXmlStreamAttributes attributes;
+    int elementIndex;  // Among the shape elements, including empty ones
+    int shapeIndex;    // Index among the parsed shapes, see onPath()
+  };
+
+  virtual ~SvgShapeVisitor() = default;
+
+  // points are sampled with the helper's SamplingPolicy whatever the
+  // ParseOutputs. Both are only valid during the call. Shapes drawn by
+  // <use> are not reported; they are the document's getInstances(), and
+  // shapeIndex leaves them out.
+  virtual void onPath(const QPainterPath& path, const QList<QPointF>& points,
+                      const ElementInfo& info) = 0;
+};
 
 class SvgHelper {
  public:
+  enum ParseMode {
+    StreamParse,  // Single pass over QXmlStreamReader, constant memory
+    DomParse,     // Load the whole file into a QDomDocument first
+  };
+
+  // How curves, arcs and round shapes are turned into points. The same
+  // policy applies to every curve segment of every shape kind; straight
+  // edges are always kept as they are. Arcs and round shapes count as one
+  // segment per quarter turn, as QPainterPath stores them.
+  struct SamplingPolicy {
+    enum Mode {
+      MaxChordError,     // value: largest distance between chord and curve
+      MaxSegmentLength,  // value: longest chord along a curve
+      FixedCount,        // value: number of chords per curve segment
+    };
+    Mode mode = MaxChordError;
+    qreal value = 0.1;  // In user units for the first two modes
+  };
+
+  enum ParseOutput {
+    PathOutput = 0x1,       // svgPathList
+    PointOutput = 0x2,      // svgPointList
+    FlatPointOutput = 0x4,  // The same points in one SvgPointStore
+    FloatPoints = 0x8,      // Store flat points as float instead of qreal
+  };
+  Q_DECLARE_FLAGS(ParseOutputs, ParseOutput)
+
+  // Shape elements parsed so far and how far into the input that is. With
+  // more than one thread most shapes are parsed after the input is read,
+  // so the count keeps rising once the bytes are done. Bytes are -1 for
+  // sequential devices, which have no position or size.
+  using ProgressCallback =
+      std::function<void(int elements, qint64 bytesRead, qint64 bytesTotal)>;
+
+  struct Results {
+    QList<QPainterPath> svgPathList;
+    QList<QList<QPointF>> svgPointList;
+  };
+
   SvgHelper() = default;
   ~SvgHelper() = default;
 
+  void setParseMode(ParseMode mode);
+  ParseMode getParseMode() const;
+
+  // Policies without a positive value are ignored with a warning. FixedCount
+  // values are rounded to a whole number of chords.
+  void setSamplingPolicy(const SamplingPolicy& policy);
+  SamplingPolicy getSamplingPolicy() const;
+
+  // Which results parseSvg keeps. With PathOutput alone no points are
+  // sampled while parsing; getSvgPointList() flattens the stored paths on
+  // first use instead; concurrent first calls flatten only once.
+  void setParseOutputs(ParseOutputs outputs);
+  ParseOutputs getParseOutputs() const;
+
+  // Threads used for the shapes of a single document. With more than one,
+  // the file is scanned once to collect the shape elements, which are then
+  // parsed in parallel and merged back in document order. 1 (the default)
+  // parses on the calling thread; <= 0 uses QThread::idealThreadCount().
+  void setThreadCount(int count);
+  int getThreadCount() const;
+
+  // Build the document's spatial index at the end of parsing instead of on
+  // the first pathsInRect()/nearestPath() query
+  void setBuildSpatialIndex(bool enabled);
+  bool getBuildSpatialIndex() const;
+
+  // Directory for a binary cache of parse results; empty (the default)
+  // disables it. A cache file is used when the source path, size and
+  // settings match and either the modification time or the SHA-1 of the
+  // contents does. It is memory-mapped and the flat point lists are read
+  // straight from the mapping; otherwise the file is parsed and the cache
+  // rewritten.
+  void setCacheDirectory(const QString& directory);
+  QString getCacheDirectory() const;
+
+  // Keep a fingerprint of every shape element's tag and attributes, so the
+  // next parseSvg() of an edited file only parses the elements that changed
+  // and copies the results of the others from the previous document. The
+  // file itself is still read in full. The fingerprints are kept in the
+  // cache as well, so an edit after a cache hit is still incremental.
+  void setIncrementalParse(bool enabled);
+  bool getIncrementalParse() const;
+
+  // Hand each shape to visitor as it is parsed, so it can be processed
+  // before the parse finishes. Together with setParseOutputs({}) nothing is
+  // kept in memory. With a visitor the shapes are parsed on the calling
+  // thread whatever the thread count, and neither the binary cache nor
+  // incremental reuse is used, so every shape is reported. Not owned; the
+  // helpers of parseSvgBatch() do not get it.
+  void setShapeVisitor(SvgShapeVisitor* visitor);
+  SvgShapeVisitor* getShapeVisitor() const;
+
+  // Called on the parsing thread every few hundred shape elements, every
+  // 100 ms while shapes are parsed in parallel, and once at the end. Not
+  // copied to the helpers of parseSvgBatch().
+  void setProgressCallback(const ProgressCallback& callback);
+  ProgressCallback getProgressCallback() const;
+
+  // Parsing checks the token and the time limit once per element, and
+  // every few tens of milliseconds while waiting on a sequential device,
+  // and stops with the shapes parsed so far; see
+  // SvgDocument::getParseStatus(). Building the DOM for DomParse is not
+  // interrupted. A limit <= 0 (the default) means none. Partial results
+  // are never cached.
+  void setCancelToken(const SvgCancelToken& token);
+  SvgCancelToken getCancelToken() const;
+  void setTimeLimit(qint64 milliseconds);
+  qint64 getTimeLimit() const;
+
+  // Apply the transform attributes of the shapes and their groups and map
+  // the root viewBox onto the document size (honouring
+  // preserveAspectRatio), so the results are in document pixels. Off by
+  // default, which keeps the raw user coordinates. Sampling tolerances
+  // hold in the units of the results; shapes that are scaled up are
+  // sampled finer.
+  void setApplyTransforms(bool enabled);
+  bool getApplyTransforms() const;
+
+  // Drop points of each sampled shape that lie within tolerance of the
+  // simplified outline (Douglas-Peucker), in the units of the results.
+  // The first and last point, and so the closure of closed shapes, are
+  // always kept. Paths are left as they are. <= 0 (the default) keeps
+  // every point.
+  void setSimplifyTolerance(qreal tolerance);
+  qreal getSimplifyTolerance() const;
+
+  // Resolve <use> elements that reference an id inside <defs> or <symbol>.
+  // The shapes there are no longer drawn where they stand; each is parsed
+  // once into the document's symbol lists, and every shape a <use> draws
+  // is an SvgInstance holding only a transform. Forward and nested
+  // references work, cycles are cut. The use's x and y always apply; its
+  // transform, and the mapping of a symbol's viewBox onto its width and
+  // height, with setApplyTransforms(). Symbol points are sampled and
+  // simplified finely enough for the most scaled-up instance of each
+  // symbol shape. Off by default, which ignores <use> and draws
+  // definitions like any other shape.
+  void setResolveUses(bool enabled);
+  bool getResolveUses() const;
+
+  // Fill a SvgParseStats on every parse and time the renders, see
+  // getParseStats(). Off by default; when off nothing is measured.
+  void setCollectStats(bool enabled);
+  bool getCollectStats() const;
+  SvgParseStats getParseStats() const;
+
   void parseSvg(const QString& filepath);
+  // Parse from memory or from an open device instead of a file. Sequential
+  // devices (pipes, sockets, processes) are read as data arrives, so
+  // parsing overlaps with the transfer. The binary cache only applies to
+  // files. Separate names for the buffers, as a string literal would
+  // convert to both QString and QByteArray.
+  void parseSvg(QIODevice* device);
+  void parseSvgData(const QByteArray& data);
+  void parseSvgData(const char* data, qsizetype size);
+
+  // Parses every file on a thread pool. Each file gets its own helper with
+  // this helper's settings; results come back in the order of filepaths.
+  // maxThreadCount <= 0 uses QThread::idealThreadCount().
+  QList<SvgHelper> parseSvgBatch(const QStringList& filepaths,
+                                 int maxThreadCount = 0) const;
+
+  // Parses filepath with the current settings without touching this
+  // helper, so it can be called from several threads at once.
+  SvgDocument parseDocument(const QString& filepath) const;
+  // Same, reusing the unchanged elements of previous when incremental
+  // parsing is on and previous was parsed that way with the same outputs
+  // and sampling policy
+  SvgDocument parseDocument(const QString& filepath,
+                            const SvgDocument& previous) const;
+  SvgDocument parseDocument(QIODevice* device) const;
+
+  // Result of the last parseSvg() call
+  SvgDocument getDocument() const;
+
+  // Both stay valid until the next parseSvg() or takeResults()
+  const QList<QPainterPath>& getSvgPathList() const;
+  // Renders the paths on white. Without a size the document size is used;
+  // otherwise the document is stretched over the requested size. The
+  // viewBox is fitted into the document as its preserveAspectRatio says.
+  QImage getSvgImage() const;
+  QImage getSvgImage(const QSize& size) const;
+  QImage getSvgImage(qreal scale) const;
+  // Draws the paths over the current contents of image, scaled to its size.
+  // Returns false if no painter could be opened on it.
+  bool renderSvgImage(QImage& image) const;
+  // Same result as renderSvgImage(), but the image is split into tiles that
+  // are drawn in parallel straight into its buffer. A tile only draws the
+  // paths whose bounds reach it. maxThreadCount <= 0 uses all cores.
+  bool renderSvgImageTiled(QImage& image,
+                           const QSize& tileSize = QSize(512, 512),
+                           int maxThreadCount = 0) const;
+
+  const QList<QList<QPointF>>& getSvgPointList() const;
+
+  // Moves the results of the last parseSvg() out and leaves this helper
+  // empty. Nothing is copied unless a SvgDocument from getDocument() still
+  // shares the data.
+  Results takeResults();
+
+ private:
+  struct ElementRecord {
+    QString tagname;
+    QXmlStreamAttributes attributes;
+    QTransform transform;  // Of the groups and the element itself
+    quint64 fingerprint = 0;
+    bool reused = false;    // Copy the previous document's result instead
+    int previousShape = -1;  // Its shape index there, -1 if it made none
+    bool definition = false;  // Inside <defs> or <symbol>
+  };
+
+  // A shape (shape >= 0) or <use> (href) inside a definition, or a <use>
+  // outside them. Transforms include the groups up to the root.
+  struct DefinitionPart {
+    int shape = -1;  // Index into the symbol lists
+    QString href;    // Referenced id, without the '#'
+    QTransform transform;
+    QSizeF size;       // A use's width and height, empty if not given
+    int position = 0;  // Parsed shapes before a <use> outside definitions
+  };
+
+  // An element with an id inside <defs> or <symbol>: the range of parts
+  // its subtree produced
+  struct Definition {
+    QString id;
+    int depth = 0;  // Element depth, while the element is open
+    int begin = 0;
+    int end = 0;
+    QTransform parentInverse;  // Undoes the transforms above the element
+    QRectF viewBox;            // Of a <symbol>
+    QString preserveAspectRatio;
+  };
+
+  // Everything a parse writes to. Each parseDocument() call and each
+  // parallel chunk has its own, which keeps the parse methods const.
+  struct ParseContext {
+    QString filepath;
+    bool rootSeen = false;
+    QSize defaultSize;
+    QRectF viewBox;
+    QString preserveAspectRatio;  // Of the root, for the image transform
+    // Transforms: the root viewBox mapping, one composed entry per open
+    // element (stream), and the transform of the element being visited
+    bool applyTransforms = false;
+    QTransform rootTransform;
+    QVector<QTransform> transformStack;
+    QTransform currentTransform;
+    int elementDepth = 0;
+    // <use> resolution: depth of the outermost open <defs> or <symbol> (0
+    // outside them), the parts and ids collected there, and the uses to
+    // resolve into instances once the whole document is read
+    bool resolveUses = false;
+    int definitionDepth = 0;
+    QVector<DefinitionPart> definitionParts;
+    QVector<Definition> openDefinitions;
+    QHash<QString, Definition> definitions;
+    QVector<DefinitionPart> uses;
+    QList<QPainterPath> symbolPathList;
+    QList<QList<QPointF>> symbolPointList;
+    QVector<SvgInstance> instances;
+    ParseOutputs outputs;
+    bool samplePoints = true;  // PointOutput or FlatPointOutput requested
+    // The helper's policy with its tolerance moved into the units of the
+    // shape being parsed, see scaledPolicy()
+    SamplingPolicy samplingPolicy;
+    QIODevice* device = nullptr;
+    int elementsSeen = 0;
+    SvgCancelToken cancelToken;
+    QDeadlineTimer deadline = QDeadlineTimer(QDeadlineTimer::Forever);
+    SvgDocument::ParseStatus status = SvgDocument::Complete;
+    bool collectStats = false;
+    SvgParseStats stats;
+    qint64 shapeNs = 0;  // parseSVGTag time, split into stats phases at the end
+    QVector<ElementRecord> pendingElements;  // Collected for parallel parsing
+    // Scratch numbers for path commands and points lists. They live as long
+    // as the parse and keep their capacity, so after the first few elements
+    // parsing allocates only for the results.
+    QVector<float> operands;
+    QVector<float> coordinates;
+    QVector<QPair<int, int>> simplifyRanges;
+    QVector<bool> simplifyKeep;
+    QPainterPath paintPath;
+    QList<QPointF> testpathlist;
+    // Still to be applied to testpathlist when it only goes to the flat
+    // stores, which map it in one pass; see storeShape()
+    QTransform pointTransform;
+    QPointF nowPositon = QPointF(0, 0);
+    QPointF pathStartPosition = QPointF(0, 0);
+    QPointF lastControlPosition = QPointF(0, 0);
+    QList<QPainterPath> svgPathList;
+    QList<QList<QPointF>> svgPointList;
+    SvgPointStore<qreal> flatPoints;
+    SvgPointStore<float> flatPointsF;
+    // Incremental parsing: one fingerprint and shape index (-1 for elements
+    // that made no shape) per element, and the previous document's ones
+    bool recordElements = false;
+    int elementCount = 0;
+    int shapeCount = 0;
+    QVector<quint64> elementHashes;
+    QVector<int> elementShapes;
+    SvgDocument previous;
+    QHash<quint64, int> previousShapes;
+
+    void addPoint(const QPointF& point) {
+      if (samplePoints) {
+        testpathlist.append(point);
+      }
+    }
+
+    bool stopRequested() {
+      if (status == SvgDocument::Complete) {
+        if (cancelToken.isCanceled()) {
+          status = SvgDocument::Canceled;
+        } else if (deadline.hasExpired()) {
+          status = SvgDocument::TimedOut;
+        }
+      }
+      return status != SvgDocument::Complete;
+    }
+  };
+
+  SvgHelper settingsCopy() const;
+  SvgDocument parseFile(const QString& filepath,
+                        const SvgDocument& previous) const;
+  SvgDocument parseDevice(QIODevice* device, const QString& filepath,
+                          const SvgDocument& previous) const;
+  QString cacheFilePath(const QString& filepath) const;
+  bool loadCache(const QString& cachePath, const QString& filepath,
+                 SvgDocument& document) const;
+  // sourceSize and sourceModified describe the file as it was before the
+  // parse; nothing is written if it changed since
+  void saveCache(const QString& cachePath, const SvgDocument& document,
+                 qint64 sourceSize, qint64 sourceModified) const;
+  QTransform imageTransform(const QSize& imageSize) const;
+  void parseSvgStream(QIODevice* device, ParseContext& context) const;
+  void startElement(QStringView name, const QXmlStreamAttributes& attributes,
+                    ParseContext& context) const;
+  void endElement(ParseContext& context) const;
+  void readRootElement(const QXmlStreamAttributes& attributes,
+                       ParseContext& context) const;
+  void parseSvgDom(QIODevice* device, ParseContext& context) const;
+  void walkDomElement(const QDomElement& element,
+                      ParseContext& context) const;
+  void visitElement(const QXmlStreamAttributes& attributes,
+                    const QString& tagname, ParseContext& context) const;
+  void parseElementsParallel(ParseContext& context) const;
+  void parseElement(const ElementRecord& element, ParseContext& context) const;
+  void reuseShape(int shape, ParseContext& context) const;
+  void storeShape(ParseContext& context) const;
+  void addUse(const ElementRecord& element, ParseContext& context) const;
+  void resolveInstances(ParseContext& context) const;
+  void instantiate(const DefinitionPart& use, const QTransform& outer,
+                   int position, QStringList& chain,
+                   ParseContext& context) const;
+  void reportProgress(const ParseContext& context, int elements) const;
+  void parseSVGTag(const QXmlStreamAttributes& attributes,
+                   const QString& tagname, const QTransform& transform,
+                   ParseContext& context) const;
+  void parseSvgPath(QStringView path, ParseContext& context) const;
+  void dealParsePainter(QChar cmd, const QVector<float>& operands,
+                        ParseContext& context) const;
+  void segmentationCoordinates(QStringView value, QVector<float>& out) const;
+  float getValueWithoutUnit(QStringView input) const;
+  double radian(double ux, double uy, double vx, double vy) const;
+  int svgArcToCenterParam(double x1, double y1, double& rx, double& ry,
+                          double phi, double fA, double fS, double x2,
+                          double y2, double& cx_out, double& cy_out,
+                          double& startAngle_out,
+                          double& deltaAngle_out) const;
+  double getAngleWithPoints(double x1, double y1, double x2, double y2,
+                            double x3, double y3) const;
+
+  ParseMode parseMode = StreamParse;
+  SamplingPolicy samplingPolicy;
+  ParseOutputs parseOutputs = ParseOutputs(PathOutput) | PointOutput;
+  int threadCount = 1;
+  bool buildSpatialIndex = false;
+  QString cacheDirectory;
+  bool incrementalParse = false;
+  SvgShapeVisitor* shapeVisitor = nullptr;
+  ProgressCallback progressCallback;
+  SvgCancelToken cancelToken;
+  qint64 timeLimit = 0;
+  bool collectStats = false;
+  bool applyTransforms = false;
+  qreal simplifyTolerance = 0;
+  bool resolveUses = false;
+  SvgDocument document;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(SvgHelper::ParseOutputs)
+
+// --- Implementation ---
+
+namespace {  // Anonymous namespace for internal linkage
+
+const QList<QChar> kCmdkTypeList = {'M', 'L', 'H', 'V', 'C',
+                                    'S', 'Q', 'T', 'A', 'Z'};
+const QList<QString> kTypeList = {"path", "rect",    "circle",  "ellipse",
+                                  "line", "polygon", "polyline"};
+const QString kUseTag = "use";
+
+// Index of name in kTypeList, or -1 if it is not a shape we handle
+int shapeTypeIndex(QStringView name) {
+  for (int i = 0; i < kTypeList.size(); ++i) {
+    if (name == QStringView(kTypeList.at(i))) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Attribute lookup with a fallback, mirroring QDomElement::attribute
+QStringView attributeValue(const QXmlStreamAttributes& attributes,
+                           const char* name,
+                           QStringView defValue = QStringView()) {
+  for (const QXmlStreamAttribute& attribute : attributes) {
+    if (attribute.qualifiedName() == QLatin1String(name)) {
+      return attribute.value();
+    }
+  }
+  return defValue;
+}
+
+// Add the counters and times of a parallel chunk
+void mergeStats(SvgParseStats& into, const SvgParseStats& from) {
+  into.tokenizeNs += from.tokenizeNs;
+  into.pointCount += from.pointCount;
+  for (auto it = from.commandCounts.begin(); it != from.commandCounts.end();
+       ++it) {
+    into.commandCounts[it.key()] += it.value();
+  }
+}
+
+// Shape elements between two progress reports
+constexpr int kProgressInterval = 256;
+constexpr int kProgressPollMs = 100;
+
+// How long a sequential device may stay silent before parsing gives up on
+// the rest of the document; QIODevice's own waitFor* default
+constexpr int kDeviceReadTimeoutMs = 30000;
+
+// Slices of that wait, between which cancellation and the time limit are
+// checked
+constexpr int kDeviceWaitSliceMs = 50;
+
+// Wait for more data on a sequential device. False at the end of a file,
+// once the writer has closed its side, or when stopRequested() turns true.
+template <typename Stop>
+bool waitForMoreData(QIODevice* device, Stop stopRequested) {
+  if (!device->isSequential()) {
+    return false;
+  }
+  const QDeadlineTimer timeout(kDeviceReadTimeoutMs);
+  while (device->bytesAvailable() <= 0) {
+    if (stopRequested() || timeout.hasExpired()) {
+      return false;
+    }
+    const int slice = int(qMin(qint64(kDeviceWaitSliceMs),
+                               qMax(qint64(1), timeout.remainingTime())));
+    QElapsedTimer waited;
+    waited.start();
+    // A false return before the slice is over means the device closed or
+    // failed rather than stayed silent
+    if (!device->waitForReadyRead(slice) && waited.elapsed() < slice) {
+      return device->bytesAvailable() > 0;
+    }
+  }
+  return true;
+}
+
+// 64-bit FNV-1a over the UTF-16 code units of text
+quint64 fingerprintAppend(quint64 hash, QStringView text) {
+  for (QChar c : text) {
+    hash = (hash ^ c.unicode()) * 1099511628211ULL;
+  }
+  // A value no code unit can take, so "ab" + "c" differs from "a" + "bc"
+  return (hash ^ 0x10000) * 1099511628211ULL;
+}
+
+quint64 fingerprintAppend(quint64 hash, const QTransform& transform) {
+  const qreal values[6] = {transform.m11(), transform.m12(), transform.m21(),
+                           transform.m22(), transform.dx(),  transform.dy()};
+  const uchar* bytes = reinterpret_cast<const uchar*>(values);
+  for (size_t i = 0; i < sizeof(values); ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Fingerprint of a shape element; equal ones parse to the same shape
+quint64 elementFingerprint(const QString& tagname,
+                           const QXmlStreamAttributes& attributes) {
+  quint64 hash = fingerprintAppend(14695981039346656037ULL, tagname);
+  for (const QXmlStreamAttribute& attribute : attributes) {
+    hash = fingerprintAppend(hash, attribute.qualifiedName());
+    hash = fingerprintAppend(hash, attribute.value());
+  }
+  return hash;
+}
+
+// Copy the attributes of a DOM element so both parse modes share parseSVGTag
+QXmlStreamAttributes domAttributes(const QDomElement& e) {
+  QXmlStreamAttributes attributes;
+  const QDomNamedNodeMap map = e.attributes();
+  for (int i = 0; i < map.count(); ++i) {
+    const QDomAttr attr = map.item(i).toAttr();
+    attributes.append(attr.name(), attr.value());
+  }
+  return attributes;
+}
+
+bool isPathCommand(QChar c) {
+  switch (c.toUpper().unicode()) {
+    case 'M':
+    case 'L':
+    case 'H':
+    case 'V':
+    case 'C':
+    case 'S':
+    case 'Q':
+    case 'T':
+    case 'A':
+    case 'Z':
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Values beyond the float range are valid SVG; they clamp to the largest
+// float instead of failing
+float narrowNumber(double value) {
+  const double limit = std::numeric_limits<float>::max();
+  return float(qBound(-limit, value, limit));
+}
+
+// Convert one already delimited number token without allocating
+bool parseNumber(QStringView text, float& value) {
+#if defined(__cpp_lib_to_chars)
+  char buffer[64];
+  if (text.size() < static_cast<qsizetype>(sizeof(buffer))) {
+    qsizetype length = 0;
+    for (QChar c : text) {
+      buffer[length++] = c.toLatin1();
+    }
+    const char* first = buffer;
+    const char* last = buffer + length;
+    if (*first == '+') {
+      ++first;  // from_chars does not accept a leading plus sign
+    }
+    // Read as double and narrow, so 1e39 is not out of range
+    double number = 0;
+    const std::from_chars_result result = std::from_chars(first, last, number);
+    if (result.ptr != last) {
+      return false;
+    }
+    if (result.ec == std::errc::result_out_of_range) {
+      // Beyond even a double: a negative exponent means it is tiny
+      const char* exponent = std::find_if(
+          first, last, [](char c) { return c == 'e' || c == 'E'; });
+      if (exponent != last && exponent[1] == '-') {
+        number = 0;
+      } else {
+        number = *first == '-' ? -std::numeric_limits<double>::max()
+                               : std::numeric_limits<double>::max();
+      }
+    } else if (result.ec != std::errc()) {
+      return false;
+    }
+    value = narrowNumber(number);
+    return true;
+  }
+#endif
+  bool ok = false;
+  const double number = QLocale::c().toDouble(text, &ok);
+  value = ok ? narrowNumber(number) : 0;
+  return ok;
+}
+
+// --- Curve flattening ---
+// Each curve is cut into uniform parameter steps. The step count follows
+// from bounds on the curve's bending and speed, so the SamplingPolicy limit
+// holds for every chord. Points are evaluated directly and appended to the
+// output list; the start point is assumed to be in the list already.
+
+using SamplingPolicy = SvgHelper::SamplingPolicy;
+
+// Guards against huge counts from tiny tolerances or degenerate input
+const int kMaxFlattenSegments = 1 << 16;
+
+int flattenSegmentCount(qreal segments) {
+  if (!(segments > 1)) {  // Also catches NaN
+    return 1;
+  }
+  return segments >= kMaxFlattenSegments ? kMaxFlattenSegments
+                                         : qCeil(segments);
+}
+
+// With n uniform steps a curve stays within errorScale / n^2 of its chords
+// and no chord is longer than speed / n
+int curveSegmentCount(const SamplingPolicy& policy, qreal errorScale,
+                      qreal speed) {
+  switch (policy.mode) {
+    case SamplingPolicy::MaxSegmentLength:
+      return flattenSegmentCount(speed / policy.value);
+    case SamplingPolicy::FixedCount:
+      return flattenSegmentCount(policy.value);
+    case SamplingPolicy::MaxChordError:
+    default:
+      return flattenSegmentCount(qSqrt(errorScale / policy.value));
+  }
+}
+
+qreal pointLength(const QPointF& p) {
+  return qSqrt(QPointF::dotProduct(p, p));
+}
+
+// Largest factor by which transform stretches a length: the larger
+// singular value of its linear part
+qreal transformScale(const QTransform& transform) {
+  const qreal a = transform.m11();
+  const qreal b = transform.m12();
+  const qreal c = transform.m21();
+  const qreal d = transform.m22();
+  const qreal half = (a * a + b * b + c * c + d * d) / 2;
+  const qreal det = a * d - b * c;
+  return qSqrt(half + qSqrt(qMax(qreal(0), half * half - det * det)));
+}
+
+// policy for sampling in units that are later stretched by up to scale, so
+// its distances still hold afterwards. Counts are left as they are.
+SamplingPolicy scaledPolicy(const SamplingPolicy& policy, qreal scale) {
+  SamplingPolicy scaled = policy;
+  if (policy.mode != SamplingPolicy::FixedCount && scale > 0) {
+    scaled.value /= scale;
+  }
+  return scaled;
+}
+
+// A cubic deviates from its chords by at most |B''|max / (8 n^2) with
+// |B''| <= 6 * max(|p0 - 2p1 + p2|, |p1 - 2p2 + p3|), and its speed is at
+// most 3 * the longest control leg. Points come from forward differencing.
+void flattenCubic(const QPointF& p0, const QPointF& p1, const QPointF& p2,
+                  const QPointF& p3, const SamplingPolicy& policy,
+                  QList<QPointF>& out) {
+  const qreal dd = qMax(pointLength(p0 - 2 * p1 + p2),
+                        pointLength(p1 - 2 * p2 + p3));
+  const qreal leg = qMax(qMax(pointLength(p1 - p0), pointLength(p2 - p1)),
+                         pointLength(p3 - p2));
+  const int n = curveSegmentCount(policy, 0.75 * dd, 3 * leg);
+
+  const qreal h = 1.0 / n;
+  const QPointF a = -p0 + 3 * p1 - 3 * p2 + p3;
+  const QPointF b = 3 * p0 - 6 * p1 + 3 * p2;
+  const QPointF c = -3 * p0 + 3 * p1;
+  QPointF point = p0;
+  QPointF d1 = a * (h * h * h) + b * (h * h) + c * h;
+  QPointF d2 = a * (6 * h * h * h) + b * (2 * h * h);
+  const QPointF d3 = a * (6 * h * h * h);
+  for (int i = 1; i < n; ++i) {
+    point += d1;
+    d1 += d2;
+    d2 += d3;
+    out.append(point);
+  }
+  out.append(p3);  // Exact end point, no accumulated drift
+}
+
+// A quadratic has the constant second derivative 2 * (p0 - 2p1 + p2) and
+// its speed is at most 2 * the longer control leg
+void flattenQuad(const QPointF& p0, const QPointF& p1, const QPointF& p2,
+                 const SamplingPolicy& policy, QList<QPointF>& out) {
+  const qreal dd = pointLength(p0 - 2 * p1 + p2);
+  const qreal leg = qMax(pointLength(p1 - p0), pointLength(p2 - p1));
+  const int n = curveSegmentCount(policy, 0.25 * dd, 2 * leg);
+
+  const qreal h = 1.0 / n;
+  const QPointF b = p0 - 2 * p1 + p2;
+  const QPointF c = 2 * (p1 - p0);
+  QPointF point = p0;
+  QPointF d1 = b * (h * h) + c * h;
+  const QPointF d2 = b * (2 * h * h);
+  for (int i = 1; i < n; ++i) {
+    point += d1;
+    d1 += d2;
+    out.append(point);
+  }
+  out.append(p2);
+}
 
-  QList<QPainterPath> getSvgPathList() const;
-  QImage getSvgImage();
+// Centre parameterisation of an SVG elliptical arc, angles in radians
+// measured in user space (y pointing down), rotation in degrees
+class EllipseArc {
+ public:
+  EllipseArc(const QPointF& center, qreal rx, qreal ry, qreal rotation,
+             qreal startAngle, qreal deltaAngle)
+      : center(center),
+        rx(rx),
+        ry(ry),
+        cosPhi(qCos(qDegreesToRadians(rotation))),
+        sinPhi(qSin(qDegreesToRadians(rotation))),
+        startAngle(startAngle),
+        deltaAngle(deltaAngle) {}
+
+  QPointF pointAt(qreal angle) const {
+    const qreal x = rx * qCos(angle);
+    const qreal y = ry * qSin(angle);
+    return QPointF(center.x() + cosPhi * x - sinPhi * y,
+                   center.y() + sinPhi * x + cosPhi * y);
+  }
+
+  QPointF tangentAt(qreal angle) const {
+    const qreal x = -rx * qSin(angle);
+    const qreal y = ry * qCos(angle);
+    return QPointF(cosPhi * x - sinPhi * y, sinPhi * x + cosPhi * y);
+  }
+
+  // Cubic pieces of at most 90 degrees, as appendTo() and QPainterPath's
+  // own ellipses build the arc
+  int pieceCount() const {
+    return flattenSegmentCount(qAbs(deltaAngle) / (M_PI / 2));
+  }
+
+  // Append the arc to path as cubic pieces of at most 90 degrees
+  void appendTo(QPainterPath& path) const {
+    const int pieces = pieceCount();
+    const qreal step = deltaAngle / pieces;
+    const qreal k = 4.0 / 3.0 * qTan(step / 4);
+    qreal angle = startAngle;
+    for (int i = 0; i < pieces; ++i) {
+      const qreal next = angle + step;
+      path.cubicTo(pointAt(angle) + k * tangentAt(angle),
+                   pointAt(next) - k * tangentAt(next), pointAt(next));
+      angle = next;
+    }
+  }
+
+  // With r the larger radius, a chord spanning dθ deviates by at most
+  // r * (1 - cos(dθ / 2)) <= r * dθ^2 / 8 and is no longer than r * dθ
+  void flatten(const SamplingPolicy& policy, QList<QPointF>& out) const {
+    const qreal r = qMax(rx, ry);
+    const qreal sweep = qAbs(deltaAngle);
+    int n = curveSegmentCount(policy, r * sweep * sweep / 8, r * sweep);
+    if (policy.mode == SamplingPolicy::FixedCount) {
+      // Counted per cubic piece, like flattenPainterPath() on the path
+      n = int(qMin(qint64(n) * pieceCount(), qint64(kMaxFlattenSegments)));
+    }
+    for (int i = 1; i <= n; ++i) {
+      out.append(pointAt(startAngle + deltaAngle * i / n));
+    }
+  }
+
+ private:
+  QPointF center;
+  qreal rx;
+  qreal ry;
+  qreal cosPhi;
+  qreal sinPhi;
+  qreal startAngle;
+  qreal deltaAngle;
+};
+
+// Closed outline of a full ellipse, starting and ending at 3 o'clock and
+// running in the same direction as QPainterPath::addEllipse
+void flattenEllipse(const QPointF& center, qreal rx, qreal ry,
+                    const SamplingPolicy& policy, QList<QPointF>& out) {
+  const EllipseArc arc(center, rx, ry, 0, 0, 2 * M_PI);
+  out.append(arc.pointAt(0));
+  arc.flatten(policy, out);
+  out.last() = out.first();  // Exact closure
+}
+
+// Closed outline of a rounded rectangle, traced like
+// QPainterPath::addRoundedRect: from the top of the right edge, corners in
+// counter-clockwise screen order
+void flattenRoundedRect(const QRectF& rect, qreal rx, qreal ry,
+                        const SamplingPolicy& policy, QList<QPointF>& out) {
+  const QPointF centers[] = {
+      QPointF(rect.right() - rx, rect.top() + ry),
+      QPointF(rect.left() + rx, rect.top() + ry),
+      QPointF(rect.left() + rx, rect.bottom() - ry),
+      QPointF(rect.right() - rx, rect.bottom() - ry),
+  };
+  const int first = out.size();
+  for (int i = 0; i < 4; ++i) {
+    const EllipseArc corner(centers[i], rx, ry, 0, -i * M_PI / 2, -M_PI / 2);
+    const QPointF start = corner.pointAt(-i * M_PI / 2);
+    if (out.size() == first || out.last() != start) {
+      out.append(start);  // End of the straight edge leading here
+    }
+    corner.flatten(policy, out);
+  }
+  out.append(out.at(first));
+}
+
+// Point list for an already built path. QPainterPath stores every curve as
+// cubics, so this is what the lazy point list uses when only paths were kept.
+void flattenPainterPath(const QPainterPath& path, const SamplingPolicy& policy,
+                        QList<QPointF>& out) {
+  QPointF current;
+  for (int i = 0; i < path.elementCount(); ++i) {
+    const QPainterPath::Element e = path.elementAt(i);
+    if (e.isCurveTo() && i + 2 < path.elementCount()) {
+      const QPointF c2 = path.elementAt(i + 1);
+      const QPointF end = path.elementAt(i + 2);
+      flattenCubic(current, e, c2, end, policy, out);
+      current = end;
+      i += 2;
+    } else {
+      current = e;
+      out.append(current);
+    }
+  }
+}
+
+// Read-only view over one command's operands. Consuming an argument group
+// just moves the cursor, so long implicit command runs stay linear.
+class OperandCursor {
+ public:
+  explicit OperandCursor(const QVector<float>& operands)
+      : data(operands.constData()), remaining(operands.size()) {}
+
+  bool has(qsizetype count) const { return remaining >= count; }
+  float operator[](qsizetype i) const { return data[i]; }
+  void advance(qsizetype count) {
+    data += count;
+    remaining -= count;
+  }
 
-  QList<QList<QPointF>> getSvgPointList() const;
+ private:
+  const float* data;
+  qsizetype remaining;
+};
+
+// Single-pass scanner for path data and number lists (d, points).
+// It reads the attribute text in place and allocates nothing per token.
+class SvgPathLexer {
+ public:
+  explicit SvgPathLexer(QStringView data) : data(data) {}
+
+  bool atEnd() {
+    skipSeparators();
+    return pos >= data.size();
+  }
+
+  // Advance to the next command letter, dropping anything that is not one
+  bool nextCommand(QChar& cmd) {
+    while (!atEnd()) {
+      const QChar c = data.at(pos++);
+      if (isPathCommand(c)) {
+        cmd = c;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Read one number; the position is left untouched if there is none
+  bool nextNumber(float& value) {
+    skipSeparators();
+    const qsizetype start = pos;
+    qsizetype i = pos;
+    if (i < data.size() && (data.at(i) == '+' || data.at(i) == '-')) {
+      ++i;
+    }
+    const qsizetype intStart = i;
+    i = skipDigits(i);
+    qsizetype digits = i - intStart;
+    if (i < data.size() && data.at(i) == '.') {
+      const qsizetype fracStart = ++i;
+      i = skipDigits(i);
+      digits += i - fracStart;
+    }
+    if (digits == 0) {
+      return false;
+    }
+    // An exponent only counts if digits follow, "2em" keeps its unit
+    if (i < data.size() && (data.at(i) == 'e' || data.at(i) == 'E')) {
+      qsizetype j = i + 1;
+      if (j < data.size() && (data.at(j) == '+' || data.at(j) == '-')) {
+        ++j;
+      }
+      const qsizetype expEnd = skipDigits(j);
+      if (expEnd > j) {
+        i = expEnd;
+      }
+    }
+    // The token is well formed, so it is consumed even if it cannot be
+    // converted; it then reads as 0, as the old QString parsing did
+    if (!parseNumber(data.mid(start, i - start), value)) {
+      value = 0;
+    }
+    pos = i;
+    return true;
+  }
+
+  // Whatever follows the last token read, e.g. the unit of a length
+  QStringView remaining() const { return data.mid(pos); }
+
+  // Arc flags are single digits and may be written without separators
+  bool nextFlag(float& value) {
+    skipSeparators();
+    if (pos < data.size() && (data.at(pos) == '0' || data.at(pos) == '1')) {
+      value = data.at(pos++) == '1' ? 1.0f : 0.0f;
+      return true;
+    }
+    return false;
+  }
+
+  void skipChar() {
+    if (pos < data.size()) {
+      ++pos;
+    }
+  }
+
+ private:
+  void skipSeparators() {
+    while (pos < data.size() &&
+           (data.at(pos).isSpace() || data.at(pos) == ',')) {
+      ++pos;
+    }
+  }
+
+  qsizetype skipDigits(qsizetype i) const {
+    while (i < data.size() && data.at(i).isDigit()) {
+      ++i;
+    }
+    return i;
+  }
+
+  QStringView data;
+  qsizetype pos = 0;
+};
+
+// Width or height of the root element in pixels, converted at 90 dpi like
+// QSvgRenderer does. -1 when missing or relative (%, em, ex).
+qreal rootLength(QStringView value) {
+  SvgPathLexer lexer(value);
+  float number;
+  if (!lexer.nextNumber(number)) {
+    return -1;
+  }
+  const QStringView unit = lexer.remaining().trimmed();
+  if (unit.isEmpty() || unit == QLatin1String("px")) {
+    return number;
+  } else if (unit == QLatin1String("pt")) {
+    return number * 1.25;
+  } else if (unit == QLatin1String("pc")) {
+    return number * 15.0;
+  } else if (unit == QLatin1String("mm")) {
+    return number * 3.543307;
+  } else if (unit == QLatin1String("cm")) {
+    return number * 35.43307;
+  } else if (unit == QLatin1String("in")) {
+    return number * 90.0;
+  }
+  return -1;
+}
+
+// Parses an SVG transform list such as "translate(10) rotate(45 5 5)". As
+// with nested groups the first item is applied last. Malformed items are
+// skipped.
+QTransform parseTransform(QStringView text) {
+  QTransform result;
+  qsizetype pos = 0;
+  while (pos < text.size()) {
+    qsizetype open = pos;
+    while (open < text.size() && text.at(open) != '(') {
+      ++open;
+    }
+    qsizetype close = open;
+    while (close < text.size() && text.at(close) != ')') {
+      ++close;
+    }
+    if (close >= text.size()) {
+      break;
+    }
+    QStringView name = text.mid(pos, open - pos).trimmed();
+    if (name.startsWith(QLatin1Char(','))) {
+      name = name.mid(1).trimmed();
+    }
+    qreal args[6];
+    int count = 0;
+    SvgPathLexer lexer(text.mid(open + 1, close - open - 1));
+    float value;
+    while (count < 6 && !lexer.atEnd()) {
+      if (lexer.nextNumber(value)) {
+        args[count++] = value;
+      } else {
+        lexer.skipChar();
+      }
+    }
+
+    QTransform item;
+    if (name == QLatin1String("matrix") && count == 6) {
+      item = QTransform(args[0], args[1], args[2], args[3], args[4], args[5]);
+    } else if (name == QLatin1String("translate") && count >= 1) {
+      item = QTransform::fromTranslate(args[0], count > 1 ? args[1] : 0);
+    } else if (name == QLatin1String("scale") && count >= 1) {
+      item = QTransform::fromScale(args[0], count > 1 ? args[1] : args[0]);
+    } else if (name == QLatin1String("rotate") && count >= 1) {
+      const qreal cx = count >= 3 ? args[1] : 0;
+      const qreal cy = count >= 3 ? args[2] : 0;
+      QTransform rotation;
+      rotation.rotate(args[0]);
+      item = QTransform::fromTranslate(-cx, -cy) * rotation *
+             QTransform::fromTranslate(cx, cy);
+    } else if (name == QLatin1String("skewX") && count == 1) {
+      item = QTransform(1, 0, qTan(qDegreesToRadians(args[0])), 1, 0, 0);
+    } else if (name == QLatin1String("skewY") && count == 1) {
+      item = QTransform(1, qTan(qDegreesToRadians(args[0])), 0, 1, 0, 0);
+    }
+    result = item * result;
+    pos = close + 1;
+  }
+  return result;
+}
+
+// Maps the viewBox onto a viewport of the given size following
+// preserveAspectRatio (xMidYMid meet when empty)
+QTransform viewBoxTransform(const QRectF& viewBox, const QSizeF& viewport,
+                            QStringView preserveAspectRatio) {
+  qreal sx = viewport.width() / viewBox.width();
+  qreal sy = viewport.height() / viewBox.height();
+  qreal tx = 0;
+  qreal ty = 0;
+  const QString value = preserveAspectRatio.toString().trimmed();
+  if (!value.startsWith(QLatin1String("none"))) {
+    const qreal scale = value.endsWith(QLatin1String("slice")) ? qMax(sx, sy)
+                                                               : qMin(sx, sy);
+    qreal alignX = 0.5;
+    qreal alignY = 0.5;
+    if (value.contains(QLatin1String("xMin"))) {
+      alignX = 0;
+    } else if (value.contains(QLatin1String("xMax"))) {
+      alignX = 1;
+    }
+    if (value.contains(QLatin1String("YMin"))) {
+      alignY = 0;
+    } else if (value.contains(QLatin1String("YMax"))) {
+      alignY = 1;
+    }
+    tx = (viewport.width() - viewBox.width() * scale) * alignX;
+    ty = (viewport.height() - viewBox.height() * scale) * alignY;
+    sx = sy = scale;
+  }
+  return QTransform(sx, 0, 0, sy, tx - viewBox.x() * sx,
+                    ty - viewBox.y() * sy);
+}
+
+// Composed transform of a DOM element and its ancestors below the root
+QTransform elementTransform(QDomElement element,
+                            const QTransform& rootTransform) {
+  QTransform transform;
+  while (!element.parentNode().toElement().isNull()) {
+    transform = transform * parseTransform(element.attribute("transform"));
+    element = element.parentNode().toElement();
+  }
+  return transform * rootTransform;
+}
+
+// Maps the points of one shape in a single pass. The coefficients are read
+// once and the loop body has no branches, so it vectorizes where the list
+// is contiguous; Qt 5 keeps each QPointF of a QList apart, so points that
+// only go to the flat stores are mapped there instead, see
+// SvgPointStore::appendShape(). Only affine transforms come out of SVG
+// attributes.
+void transformPoints(QList<QPointF>& points, const QTransform& transform) {
+  const qreal m11 = transform.m11();
+  const qreal m12 = transform.m12();
+  const qreal m21 = transform.m21();
+  const qreal m22 = transform.m22();
+  const qreal dx = transform.dx();
+  const qreal dy = transform.dy();
+  for (QPointF& point : points) {
+    const qreal x = point.x();
+    const qreal y = point.y();
+    point = QPointF(m11 * x + m21 * y + dx, m12 * x + m22 * y + dy);
+  }
+}
+
+// Index in the flat lists of parsed shape `shape` once the instance shapes
+// are merged in. Instance i goes before parsed shape index - i, which
+// never decreases along the list.
+int flatShapeIndex(const QVector<SvgInstance>& instances, int shape) {
+  int count = 0;
+  int high = int(instances.size());
+  while (count < high) {
+    const int mid = (count + high) / 2;
+    if (instances.at(mid).index - mid <= shape) {
+      count = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return shape + count;
+}
+
+// Visits the flat list order: parsed shape i through parsed(i), with the
+// instances through instance() at their indexes
+template <typename Parsed, typename Instance>
+void mergeInstances(int parsedCount, const QVector<SvgInstance>& instances,
+                    Parsed parsed, Instance instance) {
+  const int total = parsedCount + int(instances.size());
+  int next = 0;
+  for (int i = 0; i < total; ++i) {
+    if (next < instances.size() && instances.at(next).index == i) {
+      instance(instances.at(next++));
+    } else {
+      parsed(i - next);
+    }
+  }
+}
+
+QList<QPointF> instancePoints(const QList<QList<QPointF>>& symbolPoints,
+                              const SvgInstance& instance) {
+  QList<QPointF> points = symbolPoints.value(instance.shape);
+  transformPoints(points, instance.transform);
+  return points;
+}
+
+template <typename Real>
+SvgPointStore<Real> mergeFlatInstances(
+    const SvgPointsView<Real>& view,
+    const QList<QList<QPointF>>& symbolPoints,
+    const QVector<SvgInstance>& instances) {
+  SvgPointStore<Real> store;
+  mergeInstances(
+      view.shapeCount(), instances,
+      [&](int shape) { store.appendShape(view.shape(shape)); },
+      [&](const SvgInstance& instance) {
+        store.appendShape(symbolPoints.value(instance.shape),
+                          instance.transform);
+      });
+  store.squeeze();
+  return store;
+}
+
+// Pool task running a callable; QRunnable::create needs Qt 5.15
+class FunctionTask : public QRunnable {
+ public:
+  explicit FunctionTask(std::function<void()> function)
+      : function(std::move(function)) {}
+
+  void run() override { function(); }
+
+ private:
+  std::function<void()> function;
+};
+
+// A copy of path with data of its own. Copies of a QPainterPath share
+// their data until one is modified, and addPath() to an empty path builds
+// new data.
+QPainterPath detachedPath(const QPainterPath& path) {
+  QPainterPath copy;
+  copy.setFillRule(path.fillRule());
+  copy.addPath(path);
+  return copy;
+}
+
+// Below this many shapes per thread a document is parsed sequentially
+constexpr int kMinElementsPerThread = 64;
+
+// Distance from point to the segment ab
+qreal segmentDistance(const QPointF& point, const QPointF& a,
+                      const QPointF& b) {
+  const QPointF ab = b - a;
+  const qreal lengthSquared = QPointF::dotProduct(ab, ab);
+  qreal t = 0;
+  if (lengthSquared > 0) {
+    t = qBound(qreal(0), QPointF::dotProduct(point - a, ab) / lengthSquared,
+               qreal(1));
+  }
+  return pointLength(point - (a + t * ab));
+}
+
+// Distance from point to the polyline through points
+qreal polylineDistance(const QPointF& point, const QList<QPointF>& points) {
+  qreal best = std::numeric_limits<qreal>::max();
+  for (int i = 0; i < points.size(); ++i) {
+    const QPointF a = points.at(i);
+    const QPointF b = i + 1 < points.size() ? points.at(i + 1) : a;
+    best = qMin(best, segmentDistance(point, a, b));
+  }
+  return best;
+}
+
+// Douglas-Peucker in place: keeps the end points and, recursively, the
+// point farthest from the segment between two kept ones while it is more
+// than tolerance away. A closed shape's segment is a single point, so its
+// farthest point splits it first. ranges and keep are scratch buffers.
+void simplifyPoints(QList<QPointF>& points, qreal tolerance,
+                    QVector<QPair<int, int>>& ranges, QVector<bool>& keep) {
+  const int count = int(points.size());
+  if (count < 3) {
+    return;
+  }
+  keep.fill(false, count);
+  keep[0] = keep[count - 1] = true;
+  ranges.clear();
+  ranges.append(qMakePair(0, count - 1));
+  while (!ranges.isEmpty()) {
+    const QPair<int, int> range = ranges.takeLast();
+    const QPointF a = points.at(range.first);
+    const QPointF b = points.at(range.second);
+    qreal farthest = tolerance;
+    int split = -1;
+    for (int i = range.first + 1; i < range.second; ++i) {
+      const qreal distance = segmentDistance(points.at(i), a, b);
+      if (distance > farthest) {
+        farthest = distance;
+        split = i;
+      }
+    }
+    if (split >= 0) {
+      keep[split] = true;
+      ranges.append(qMakePair(range.first, split));
+      ranges.append(qMakePair(split, range.second));
+    }
+  }
+
+  int kept = 0;
+  for (int i = 0; i < count; ++i) {
+    if (keep.at(i)) {
+      points[kept++] = points.at(i);
+    }
+  }
+  points.erase(points.begin() + kept, points.end());
+}
+
+// Distance from point to rect, 0 inside
+qreal rectDistance(const QPointF& point, const QRectF& rect) {
+  const qreal dx = qMax(qMax(rect.left() - point.x(), point.x() - rect.right()),
+                        qreal(0));
+  const qreal dy = qMax(qMax(rect.top() - point.y(), point.y() - rect.bottom()),
+                        qreal(0));
+  return std::sqrt(dx * dx + dy * dy);
+}
+
+// Uniform grid over path bounds, about one cell per path. Each cell lists
+// the paths whose bounds overlap it; paths that would span too many cells
+// are kept in a separate list that every query checks.
+class PathGrid {
+ public:
+  void build(const QVector<QRectF>& bounds) {
+    if (bounds.isEmpty()) {
+      return;
+    }
+    area = bounds.first().normalized();
+    for (const QRectF& rect : bounds) {
+      const QRectF r = rect.normalized();
+      area.setLeft(qMin(area.left(), r.left()));
+      area.setTop(qMin(area.top(), r.top()));
+      area.setRight(qMax(area.right(), r.right()));
+      area.setBottom(qMax(area.bottom(), r.bottom()));
+    }
+    // Keep cells non-degenerate when every path lies on one line
+    area.setWidth(qMax(area.width(), qreal(1)));
+    area.setHeight(qMax(area.height(), qreal(1)));
+    const qreal aspect = area.width() / area.height();
+    columns = int(qBound(qreal(1), std::sqrt(bounds.size() * aspect),
+                         qreal(kMaxGridSide)));
+    rows = int(qBound(qreal(1), qreal(bounds.size()) / columns,
+                      qreal(kMaxGridSide)));
+    cellWidth = area.width() / columns;
+    cellHeight = area.height() / rows;
+
+    // Counting pass, then a fill pass into one flat array (CSR layout)
+    QVector<int> counts(columns * rows + 1, 0);
+    for (int i = 0; i < bounds.size(); ++i) {
+      const QRect cells = cellRange(bounds.at(i));
+      if (cells.width() * cells.height() > kMaxCellsPerPath) {
+        oversized.append(i);
+        continue;
+      }
+      forEachCell(cells, [&](int cell) { ++counts[cell + 1]; });
+    }
+    for (int cell = 0; cell < columns * rows; ++cell) {
+      counts[cell + 1] += counts[cell];
+    }
+    cellStart = counts;
+    cellItems.resize(counts.last());
+    for (int i = 0; i < bounds.size(); ++i) {
+      const QRect cells = cellRange(bounds.at(i));
+      if (cells.width() * cells.height() <= kMaxCellsPerPath) {
+        forEachCell(cells, [&](int cell) { cellItems[counts[cell]++] = i; });
+      }
+    }
+  }
+
+  // Indexes of the paths whose bounds intersect rect, in ascending order
+  QVector<int> query(const QRectF& rect, const QVector<QRectF>& bounds) const {
+    QVector<int> result;
+    if (columns == 0) {
+      return result;
+    }
+    const QRectF target = rect.normalized();
+    auto test = [&](int i) {
+      const QRectF b = bounds.at(i).normalized();
+      if (b.left() <= target.right() && target.left() <= b.right() &&
+          b.top() <= target.bottom() && target.top() <= b.bottom()) {
+        result.append(i);
+      }
+    };
+    for (int i : oversized) {
+      test(i);
+    }
+    forEachCell(cellRange(target), [&](int cell) {
+      for (int k = cellStart.at(cell); k < cellStart.at(cell + 1); ++k) {
+        test(cellItems.at(k));
+      }
+    });
+    // A path overlapping several cells is found once per cell
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+  }
+
+  // Path with the smallest distance(index) to point, searching rings of
+  // cells outwards until no closer path can remain; -1 if none is within
+  // maxDistance (< 0 for no limit). distance is only called for paths whose
+  // bounds are close enough to matter.
+  int nearest(const QPointF& point, qreal maxDistance,
+              const QVector<QRectF>& bounds,
+              const std::function<qreal(int)>& distance) const {
+    if (columns == 0) {
+      return -1;
+    }
+    int best = -1;
+    qreal bestDistance =
+        maxDistance < 0 ? std::numeric_limits<qreal>::max() : maxDistance;
+    QSet<int> seen;
+    auto test = [&](int i) {
+      if (rectDistance(point, bounds.at(i)) > bestDistance) {
+        return;
+      }
+      if (seen.contains(i)) {
+        return;
+      }
+      seen.insert(i);
+      const qreal d = distance(i);
+      if (d < bestDistance || (d == bestDistance && best < 0)) {
+        best = i;
+        bestDistance = d;
+      }
+    };
+    auto testCell = [&](int x, int y) {
+      if (x < 0 || y < 0 || x >= columns || y >= rows) {
+        return;
+      }
+      const int cell = y * columns + x;
+      for (int k = cellStart.at(cell); k < cellStart.at(cell + 1); ++k) {
+        test(cellItems.at(k));
+      }
+    };
+    for (int i : oversized) {
+      test(i);
+    }
+    // Cells on ring r are at least r - 1 cells away from the point's
+    // projection onto the grid, and no closer to the point itself
+    const QPoint c = cellAt(point);
+    const qreal step = qMin(cellWidth, cellHeight);
+    const int maxRing = qMax(columns, rows);
+    for (int r = 0; r <= maxRing && (r - 1) * step <= bestDistance; ++r) {
+      for (int x = c.x() - r; x <= c.x() + r; ++x) {
+        testCell(x, c.y() - r);
+        if (r > 0) {
+          testCell(x, c.y() + r);
+        }
+      }
+      for (int y = c.y() - r + 1; y <= c.y() + r - 1; ++y) {
+        testCell(c.x() - r, y);
+        testCell(c.x() + r, y);
+      }
+    }
+    return best;
+  }
+
+ private:
+  static constexpr int kMaxGridSide = 1024;
+  static constexpr int kMaxCellsPerPath = 256;
+
+  QPoint cellAt(const QPointF& point) const {
+    return QPoint(
+        qBound(0, int((point.x() - area.left()) / cellWidth), columns - 1),
+        qBound(0, int((point.y() - area.top()) / cellHeight), rows - 1));
+  }
+
+  QRect cellRange(const QRectF& rect) const {
+    const QRectF r = rect.normalized();
+    return QRect(cellAt(r.topLeft()), cellAt(r.bottomRight()));
+  }
+
+  template <typename Visit>
+  void forEachCell(const QRect& cells, Visit visit) const {
+    for (int y = cells.top(); y <= cells.bottom(); ++y) {
+      for (int x = cells.left(); x <= cells.right(); ++x) {
+        visit(y * columns + x);
+      }
+    }
+  }
+
+  QRectF area;
+  int columns = 0;
+  int rows = 0;
+  qreal cellWidth = 0;
+  qreal cellHeight = 0;
+  QVector<int> cellStart;  // columns * rows + 1 offsets into cellItems
+  QVector<int> cellItems;
+  QVector<int> oversized;
+};
+
+// --- Binary cache ---
+//
+// Layout: CacheHeader, the source path (UTF-8), then the arrays listed in
+// the header. Every block starts 8-byte aligned so the mapped file can be
+// read in place. The file is only meant for the machine that wrote it;
+// byteOrder and qrealSize reject anything else.
+
+constexpr char kCacheMagic[8] = {'S', 'V', 'G', 'H', 'C', 'A', 'C', 'H'};
+constexpr quint32 kCacheVersion = 7;
+constexpr quint32 kCacheByteOrder = 0x01020304;
+
+struct CacheHeader {
+  char magic[8];
+  quint32 version;
+  quint32 byteOrder;
+  quint32 qrealSize;
+  quint32 sourcePathSize;  // UTF-8 bytes following the header
+  qint64 sourceSize;
+  qint64 sourceModified;  // ms since epoch
+  char sourceHash[20];    // SHA-1 of the source file
+  // Settings that change the results
+  quint32 outputs;
+  quint32 samplingMode;
+  double samplingValue;
+  quint32 pointListPending;
+  qint32 width;
+  qint32 height;
+  quint32 pathCount;       // Element offsets, types, x and y follow
+  double viewBox[4];
+  quint32 pointListCount;  // Offsets, x and y follow
+  quint32 flatCount;       // Offsets, x and y (qreal) follow
+  quint32 flatFCount;      // Offsets, x and y (float) follow
+  quint32 applyTransforms;
+  quint32 resolveUses;
+  double simplifyTolerance;
+  quint32 symbolPathCount;       // Like the paths
+  quint32 symbolPointListCount;  // Like the point lists
+  quint32 instanceCount;         // Shapes, indexes and transforms follow
+  quint32 parseMode;             // DomParse orders nested shapes by type
+  quint32 aspectRatioSize;       // UTF-8 bytes following the source path
+  quint32 elementsRecorded;      // Written with incremental parsing on
+  quint32 elementCount;          // Fingerprints and shape numbers follow
+};
+
+class CacheWriter {
+ public:
+  explicit CacheWriter(QIODevice* device) : device(device) {}
+
+  template <typename T>
+  void writeArray(const T* data, qint64 count) {
+    write(data, count * qint64(sizeof(T)));
+  }
+
+  void write(const void* data, qint64 size) {
+    ok = ok && device->write(static_cast<const char*>(data), size) == size;
+    position += size;
+    static const char kPadding[8] = {};
+    const qint64 padding = (8 - position % 8) % 8;
+    ok = ok && device->write(kPadding, padding) == padding;
+    position += padding;
+  }
+
+  bool ok = true;
+
+ private:
+  QIODevice* device;
+  qint64 position = 0;
+};
+
+class CacheReader {
+ public:
+  CacheReader(const uchar* data, qint64 size) : data(data), size(size) {}
+
+  // Next count values in place, nullptr if the file is too short
+  template <typename T>
+  const T* array(qint64 count) {
+    const qint64 bytes = count * qint64(sizeof(T));
+    if (count < 0 || bytes > size - position) {
+      return nullptr;
+    }
+    const T* result = reinterpret_cast<const T*>(data + position);
+    position += (bytes + 7) / 8 * 8;
+    return result;
+  }
+
+ private:
+  const uchar* data;
+  qint64 size;
+  qint64 position = 0;
+};
+
+// A count of entries a file of fileSize bytes can hold, small enough to
+// stay a positive int with one added
+bool validCount(quint32 count, qint64 fileSize) {
+  return count < quint32(std::numeric_limits<int>::max()) &&
+         qint64(count) <= fileSize;
+}
+
+// Offsets must start at 0, never decrease and stay within total
+template <typename Offset>
+bool validOffsets(const Offset* offsets, int count, qint64 total) {
+  if (!offsets || offsets[0] != 0) {
+    return false;
+  }
+  for (int i = 0; i < count; ++i) {
+    if (offsets[i + 1] < offsets[i]) {
+      return false;
+    }
+  }
+  return offsets[count] <= total;
+}
+
+// Paths as element offsets, types, x and y
+void writePaths(CacheWriter& writer, const QList<QPainterPath>& paths) {
+  QVector<quint32> offsets(1, 0);
+  QVector<quint8> types;
+  QVector<double> xs;
+  QVector<double> ys;
+  for (const QPainterPath& path : paths) {
+    for (int i = 0; i < path.elementCount(); ++i) {
+      const QPainterPath::Element e = path.elementAt(i);
+      types.append(quint8(e.type));
+      xs.append(e.x);
+      ys.append(e.y);
+    }
+    offsets.append(quint32(xs.size()));
+  }
+  writer.writeArray(offsets.constData(), offsets.size());
+  writer.writeArray(types.constData(), types.size());
+  writer.writeArray(xs.constData(), xs.size());
+  writer.writeArray(ys.constData(), ys.size());
+}
+
+// Paths are rebuilt, QPainterPath cannot wrap foreign memory
+bool readPaths(CacheReader& reader, int count, QList<QPainterPath>& paths) {
+  const quint32* elementOffsets = reader.array<quint32>(count + 1);
+  const qint64 elementCount = elementOffsets ? elementOffsets[count] : 0;
+  const quint8* types = reader.array<quint8>(elementCount);
+  const double* xs = reader.array<double>(elementCount);
+  const double* ys = reader.array<double>(elementCount);
+  if (!validOffsets(elementOffsets, count, elementCount) || !types || !xs ||
+      !ys) {
+    return false;
+  }
+  paths.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    QPainterPath path;
+    for (quint32 e = elementOffsets[i]; e < elementOffsets[i + 1]; ++e) {
+      if (types[e] == QPainterPath::MoveToElement) {
+        path.moveTo(xs[e], ys[e]);
+      } else if (types[e] == QPainterPath::LineToElement) {
+        path.lineTo(xs[e], ys[e]);
+      } else if (types[e] == QPainterPath::CurveToElement &&
+                 e + 2 < elementOffsets[i + 1]) {
+        path.cubicTo(xs[e], ys[e], xs[e + 1], ys[e + 1], xs[e + 2], ys[e + 2]);
+        e += 2;
+      }
+    }
+    paths.append(path);
+  }
+  return true;
+}
+
+// Point lists as offsets, x and y
+void writePointLists(CacheWriter& writer,
+                     const QList<QList<QPointF>>& pointLists) {
+  QVector<quint32> offsets(1, 0);
+  QVector<double> xs;
+  QVector<double> ys;
+  for (const QList<QPointF>& points : pointLists) {
+    for (const QPointF& point : points) {
+      xs.append(point.x());
+      ys.append(point.y());
+    }
+    offsets.append(quint32(xs.size()));
+  }
+  writer.writeArray(offsets.constData(), offsets.size());
+  writer.writeArray(xs.constData(), xs.size());
+  writer.writeArray(ys.constData(), ys.size());
+}
+
+bool readPointLists(CacheReader& reader, int count,
+                    QList<QList<QPointF>>& pointLists) {
+  const quint32* offsets = reader.array<quint32>(count + 1);
+  const qint64 pointCount = offsets ? offsets[count] : 0;
+  const double* xs = reader.array<double>(pointCount);
+  const double* ys = reader.array<double>(pointCount);
+  if (!validOffsets(offsets, count, pointCount) || !xs || !ys) {
+    return false;
+  }
+  pointLists.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    QList<QPointF> points;
+    points.reserve(int(offsets[i + 1] - offsets[i]));
+    for (quint32 k = offsets[i]; k < offsets[i + 1]; ++k) {
+      points.append(QPointF(xs[k], ys[k]));
+    }
+    pointLists.append(points);
+  }
+  return true;
+}
+
+QByteArray fileHash(const QString& filepath) {
+  QFile file(filepath);
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  if (file.open(QFile::ReadOnly)) {
+    hash.addData(&file);
+  }
+  return hash.result();
+}
+
+}  // namespace
+
+struct SvgDocument::Data {
+  QString filepath;
+  QSize defaultSize;
+  QRectF viewBox;
+  QString preserveAspectRatio;
+  // Mutable for the instances merged in on first use, see ensureInstances()
+  mutable QList<QPainterPath> svgPathList;
+  mutable QList<QList<QPointF>> svgPointList;
+  mutable SvgPointStore<qreal> flatPoints;
+  mutable SvgPointStore<float> flatPointsF;
+  // Set when only paths were parsed; svgPointList is filled on first use
+  bool pointListPending = false;
+  SvgHelper::SamplingPolicy samplingPolicy;
+  qreal simplifyTolerance = 0;
+  SvgHelper::ParseOutputs outputs;
+  SvgDocument::ParseStatus status = SvgDocument::Complete;
+  // Coordinates are in document pixels, not viewBox units
+  bool transformsApplied = false;
+  SvgParseStats stats;
+  mutable std::atomic<qint64> renderNs{0};
+  // Filled with incremental parsing, see ParseContext
+  QVector<quint64> elementHashes;
+  QVector<int> elementShapes;
+  // With setResolveUses(), see getInstances()
+  QList<QPainterPath> symbolPathList;
+  QList<QList<QPointF>> symbolPointList;
+  QVector<SvgInstance> instances;
+  mutable std::once_flag instancesOnce;
+  mutable std::once_flag pointListOnce;
+  mutable QVector<QRectF> pathBounds;
+  mutable std::once_flag pathBoundsOnce;
+  mutable PathGrid spatialIndex;
+  mutable std::once_flag spatialIndexOnce;
+  // Views of flatPoints/flatPointsF, or into cacheMapping when the document
+  // was loaded from the binary cache
+  mutable SvgPointsView<qreal> flatPointsView;
+  mutable SvgPointsView<float> flatPointsFView;
+  std::shared_ptr<QFile> cacheMapping;
+};
+
+void SvgHelper::setParseMode(ParseMode mode) {
+  parseMode = mode;
+}
+
+SvgHelper::ParseMode SvgHelper::getParseMode() const {
+  return parseMode;
+}
+
+void SvgHelper::setSamplingPolicy(const SamplingPolicy& policy) {
+  if (!(policy.value > 0)) {  // Also catches NaN
+    qWarning() << "Ignoring sampling policy with non-positive value"
+               << policy.value;
+    return;
+  }
+  samplingPolicy = policy;
+  if (policy.mode == SamplingPolicy::FixedCount) {
+    samplingPolicy.value = qRound(
+        qBound(qreal(1), policy.value, qreal(kMaxFlattenSegments)));
+  }
+}
+
+SvgHelper::SamplingPolicy SvgHelper::getSamplingPolicy() const {
+  return samplingPolicy;
+}
+
+void SvgHelper::setParseOutputs(ParseOutputs outputs) {
+  parseOutputs = outputs;
+}
+
+SvgHelper::ParseOutputs SvgHelper::getParseOutputs() const {
+  return parseOutputs;
+}
+
+void SvgHelper::setThreadCount(int count) {
+  threadCount = count;
+}
+
+int SvgHelper::getThreadCount() const {
+  return threadCount;
+}
+
+void SvgHelper::setBuildSpatialIndex(bool enabled) {
+  buildSpatialIndex = enabled;
+}
+
+bool SvgHelper::getBuildSpatialIndex() const {
+  return buildSpatialIndex;
+}
+
+void SvgHelper::setCacheDirectory(const QString& directory) {
+  cacheDirectory = directory;
+}
+
+QString SvgHelper::getCacheDirectory() const {
+  return cacheDirectory;
+}
+
+void SvgHelper::setIncrementalParse(bool enabled) {
+  incrementalParse = enabled;
+}
+
+bool SvgHelper::getIncrementalParse() const {
+  return incrementalParse;
+}
+
+void SvgHelper::setShapeVisitor(SvgShapeVisitor* visitor) {
+  shapeVisitor = visitor;
+}
+
+SvgShapeVisitor* SvgHelper::getShapeVisitor() const {
+  return shapeVisitor;
+}
+
+void SvgHelper::setProgressCallback(const ProgressCallback& callback) {
+  progressCallback = callback;
+}
+
+SvgHelper::ProgressCallback SvgHelper::getProgressCallback() const {
+  return progressCallback;
+}
+
+void SvgHelper::setCancelToken(const SvgCancelToken& token) {
+  cancelToken = token;
+}
+
+SvgCancelToken SvgHelper::getCancelToken() const {
+  return cancelToken;
+}
+
+void SvgHelper::setTimeLimit(qint64 milliseconds) {
+  timeLimit = milliseconds;
+}
+
+qint64 SvgHelper::getTimeLimit() const {
+  return timeLimit;
+}
+
+void SvgHelper::setCollectStats(bool enabled) {
+  collectStats = enabled;
+}
+
+bool SvgHelper::getCollectStats() const {
+  return collectStats;
+}
+
+void SvgHelper::setApplyTransforms(bool enabled) {
+  applyTransforms = enabled;
+}
+
+bool SvgHelper::getApplyTransforms() const {
+  return applyTransforms;
+}
+
+void SvgHelper::setSimplifyTolerance(qreal tolerance) {
+  simplifyTolerance = tolerance;
+}
+
+qreal SvgHelper::getSimplifyTolerance() const {
+  return simplifyTolerance;
+}
+
+void SvgHelper::setResolveUses(bool enabled) {
+  resolveUses = enabled;
+}
+
+bool SvgHelper::getResolveUses() const {
+  return resolveUses;
+}
+
+SvgParseStats SvgHelper::getParseStats() const {
+  return document.getParseStats();
+}
+
+SvgHelper SvgHelper::settingsCopy() const {
+  // Settings only; results of an earlier parse on this helper stay here
+  SvgHelper settings;
+  settings.parseMode = parseMode;
+  settings.samplingPolicy = samplingPolicy;
+  settings.parseOutputs = parseOutputs;
+  settings.threadCount = threadCount;
+  settings.buildSpatialIndex = buildSpatialIndex;
+  settings.cacheDirectory = cacheDirectory;
+  settings.incrementalParse = incrementalParse;
+  settings.cancelToken = cancelToken;
+  settings.timeLimit = timeLimit;
+  settings.collectStats = collectStats;
+  settings.applyTransforms = applyTransforms;
+  settings.simplifyTolerance = simplifyTolerance;
+  settings.resolveUses = resolveUses;
+  return settings;
+}
+
+void SvgHelper::parseSvg(const QString& filepath) {
+  // Only an incremental parse reads the previous results; otherwise they
+  // are released first so both documents are never held at once
+  if (!incrementalParse) {
+    document = SvgDocument();
+  }
+  document = parseDocument(filepath, document);
+}
+
+void SvgHelper::parseSvg(QIODevice* device) {
+  if (!incrementalParse) {
+    document = SvgDocument();
+  }
+  document = parseDevice(device, QString(), document);
+}
+
+void SvgHelper::parseSvgData(const QByteArray& data) {
+  QBuffer buffer;
+  buffer.setData(data);  // Shares data, no copy
+  buffer.open(QIODevice::ReadOnly);
+  parseSvg(&buffer);
+}
+
+void SvgHelper::parseSvgData(const char* data, qsizetype size) {
+  // Wraps the caller's memory, which only has to live until this returns
+  parseSvgData(QByteArray::fromRawData(data, size));
+}
+
+SvgDocument SvgHelper::parseDocument(const QString& filepath) const {
+  return parseDocument(filepath, SvgDocument());
+}
+
+SvgDocument SvgHelper::parseDocument(const QString& filepath,
+                                     const SvgDocument& previous) const {
+  const QString cachePath = cacheFilePath(filepath);
+  SvgDocument result;
+  QElapsedTimer timer;
+  if (collectStats) {
+    timer.start();
+  }
+  if (!cachePath.isEmpty() && loadCache(cachePath, filepath, result)) {
+    if (collectStats) {
+      // Nothing else refers to the freshly loaded data yet
+      SvgParseStats& stats = const_cast<SvgDocument::Data&>(*result.d).stats;
+      stats.cacheHit = true;
+      stats.totalNs = timer.nsecsElapsed();
+      stats.shapeCount = int(result.getSvgPathList().size());
+    }
+  } else {
+    // Taken before parsing, so a file saved again meanwhile is not cached
+    // under its new key with the old geometry
+    const QFileInfo source(filepath);
+    const qint64 sourceSize = source.size();
+    const qint64 sourceModified = source.lastModified().toMSecsSinceEpoch();
+    result = parseFile(filepath, previous);
+    if (!cachePath.isEmpty() && QFileInfo::exists(filepath) &&
+        result.getParseStatus() == SvgDocument::Complete) {
+      saveCache(cachePath, result, sourceSize, sourceModified);
+    }
+  }
+  if (buildSpatialIndex) {
+    result.ensureSpatialIndex();
+  }
+  return result;
+}
+
+SvgDocument SvgHelper::parseDocument(QIODevice* device) const {
+  SvgDocument result = parseDevice(device, QString(), SvgDocument());
+  if (buildSpatialIndex) {
+    result.ensureSpatialIndex();
+  }
+  return result;
+}
+
+SvgDocument SvgHelper::parseFile(const QString& filepath,
+                                 const SvgDocument& previous) const {
+  QFile svgFile(filepath);
+  if (!svgFile.open(QFile::ReadOnly)) {
+    qWarning() << "Failed to open SVG file for reading:" << filepath;
+  }
+  return parseDevice(&svgFile, filepath, previous);
+}
+
+SvgDocument SvgHelper::parseDevice(QIODevice* device, const QString& filepath,
+                                   const SvgDocument& previous) const {
+  ParseContext context;
+  context.filepath = filepath;
+  context.outputs = parseOutputs;
+  context.samplePoints = parseOutputs.testFlag(PointOutput) ||
+                         parseOutputs.testFlag(FlatPointOutput) ||
+                         shapeVisitor;
+  context.device = device;
+  context.applyTransforms = applyTransforms;
+  context.resolveUses = resolveUses;
+  context.collectStats = collectStats;
+  context.cancelToken = cancelToken;
+  if (timeLimit > 0) {
+    context.deadline = QDeadlineTimer(timeLimit);
+  }
+  if (incrementalParse) {
+    context.recordElements = true;
+    // Fingerprints only cover the attributes, so the results are only
+    // interchangeable when they were produced the same way
+    const SvgDocument::Data& old = *previous.d;
+    if (!shapeVisitor && old.outputs == parseOutputs &&
+        old.samplingPolicy.mode == samplingPolicy.mode &&
+        old.samplingPolicy.value == samplingPolicy.value &&
+        old.simplifyTolerance == simplifyTolerance) {
+      // Reused shapes are read from the flat lists, see reuseShape()
+      previous.ensureInstances();
+      context.previous = previous;
+      context.previousShapes.reserve(old.elementHashes.size());
+      for (int i = 0; i < old.elementHashes.size(); ++i) {
+        context.previousShapes.insert(old.elementHashes.at(i),
+                                      old.elementShapes.at(i));
+      }
+    }
+  }
+
+  if (device && device->isReadable()) {
+    QElapsedTimer timer;
+    if (collectStats) {
+      timer.start();
+    }
+    if (parseMode == StreamParse) {
+      parseSvgStream(device, context);
+    } else {
+      parseSvgDom(device, context);
+    }
+    if (collectStats) {
+      // Shapes parsed so far ran on this thread during the walk
+      context.stats.documentNs = timer.nsecsElapsed() - context.shapeNs;
+    }
+    parseElementsParallel(context);
+    resolveInstances(context);
+    reportProgress(context, context.elementsSeen);
+    if (collectStats) {
+      SvgParseStats& stats = context.stats;
+      stats.totalNs = timer.nsecsElapsed();
+      stats.geometryNs = context.shapeNs - stats.tokenizeNs;
+      stats.shapeCount = context.shapeCount + int(context.instances.size());
+      if (!device->isSequential()) {
+        stats.bytesRead = device->pos();
+      }
+    }
+  } else if (filepath.isEmpty()) {
+    qWarning() << "SVG device is not open for reading";
+  }
+
+  auto data = std::make_shared<SvgDocument::Data>();
+  data->filepath = filepath;
+  data->defaultSize = context.defaultSize;
+  data->viewBox = context.viewBox;
+  data->preserveAspectRatio = context.preserveAspectRatio;
+  data->svgPathList = std::move(context.svgPathList);
+  data->svgPointList = std::move(context.svgPointList);
+  data->flatPoints = std::move(context.flatPoints);
+  data->flatPoints.squeeze();
+  data->flatPointsF = std::move(context.flatPointsF);
+  data->flatPointsF.squeeze();
+  data->pointListPending = !parseOutputs.testFlag(PointOutput) &&
+                           parseOutputs.testFlag(PathOutput);
+  data->samplingPolicy = samplingPolicy;
+  data->simplifyTolerance = simplifyTolerance;
+  data->outputs = parseOutputs;
+  data->status = context.status;
+  data->transformsApplied = applyTransforms;
+  data->stats = std::move(context.stats);
+  data->elementHashes = std::move(context.elementHashes);
+  data->elementShapes = std::move(context.elementShapes);
+  data->symbolPathList = std::move(context.symbolPathList);
+  data->symbolPointList = std::move(context.symbolPointList);
+  data->instances = std::move(context.instances);
+  data->flatPointsView = data->flatPoints.view();
+  data->flatPointsFView = data->flatPointsF.view();
+  SvgDocument result;
+  result.d = data;
+  return result;
+}
+
+QString SvgHelper::cacheFilePath(const QString& filepath) const {
+  // A cached document would skip the parse the visitor waits for
+  if (cacheDirectory.isEmpty() || shapeVisitor) {
+    return QString();
+  }
+  const QByteArray key = QCryptographicHash::hash(
+      QFileInfo(filepath).absoluteFilePath().toUtf8(),
+      QCryptographicHash::Sha1);
+  return QDir(cacheDirectory)
+      .filePath(QString::fromLatin1(key.toHex()) + ".svgcache");
+}
+
+bool SvgHelper::loadCache(const QString& cachePath, const QString& filepath,
+                          SvgDocument& document) const {
+  const QFileInfo source(filepath);
+  auto file = std::make_shared<QFile>(cachePath);
+  if (!source.exists() || !file->open(QFile::ReadOnly)) {
+    return false;
+  }
+  const uchar* mapped = file->map(0, file->size());
+  if (!mapped) {
+    return false;
+  }
+  CacheReader reader(mapped, file->size());
+
+  const CacheHeader* header = reader.array<CacheHeader>(1);
+  if (!header || memcmp(header->magic, kCacheMagic, 8) != 0 ||
+      header->version != kCacheVersion ||
+      header->byteOrder != kCacheByteOrder ||
+      header->qrealSize != sizeof(qreal)) {
+    return false;
+  }
+  // Every count is cast to int and gets 1 added for its offsets
+  const quint32 counts[] = {header->sourcePathSize,
+                            header->pathCount,
+                            header->pointListCount,
+                            header->flatCount,
+                            header->flatFCount,
+                            header->symbolPathCount,
+                            header->symbolPointListCount,
+                            header->instanceCount,
+                            header->aspectRatioSize,
+                            header->elementCount};
+  for (quint32 count : counts) {
+    if (!validCount(count, file->size())) {
+      return false;
+    }
+  }
+  const char* sourcePath = reader.array<char>(header->sourcePathSize);
+  if (!sourcePath ||
+      QString::fromUtf8(sourcePath, int(header->sourcePathSize)) !=
+          source.absoluteFilePath() ||
+      header->sourceSize != source.size() ||
+      header->outputs != quint32(parseOutputs) ||
+      header->samplingMode != quint32(samplingPolicy.mode) ||
+      header->samplingValue != samplingPolicy.value ||
+      header->applyTransforms != quint32(applyTransforms) ||
+      header->resolveUses != quint32(resolveUses) ||
+      header->parseMode != quint32(parseMode) ||
+      header->simplifyTolerance != simplifyTolerance) {
+    return false;
+  }
+  // Without fingerprints the next incremental parse would start over
+  if (incrementalParse && !header->elementsRecorded) {
+    return false;
+  }
+  const char* aspectRatio = reader.array<char>(header->aspectRatioSize);
+  if (!aspectRatio) {
+    return false;
+  }
+  // A touched but unchanged file still hits the cache
+  if (header->sourceModified !=
+          source.lastModified().toMSecsSinceEpoch() &&
+      fileHash(filepath) != QByteArray(header->sourceHash, 20)) {
+    return false;
+  }
+
+  auto data = std::make_shared<SvgDocument::Data>();
+  data->filepath = filepath;
+  data->defaultSize = QSize(header->width, header->height);
+  data->viewBox = QRectF(header->viewBox[0], header->viewBox[1],
+                         header->viewBox[2], header->viewBox[3]);
+  data->preserveAspectRatio =
+      QString::fromUtf8(aspectRatio, int(header->aspectRatioSize));
+  data->pointListPending = header->pointListPending != 0;
+  data->samplingPolicy = samplingPolicy;
+  data->outputs = parseOutputs;
+  data->transformsApplied = applyTransforms;
+  data->simplifyTolerance = simplifyTolerance;
+
+  if (!readPaths(reader, int(header->pathCount), data->svgPathList) ||
+      !readPointLists(reader, int(header->pointListCount),
+                      data->svgPointList)) {
+    return false;
+  }
+
+  // Flat points are used in place
+  const int flatCount = int(header->flatCount);
+  const int* flatOffsets = reader.array<int>(flatCount + 1);
+  const qint64 flatPointCount = flatOffsets ? flatOffsets[flatCount] : 0;
+  const qreal* flatXs = reader.array<qreal>(flatPointCount);
+  const qreal* flatYs = reader.array<qreal>(flatPointCount);
+  const int flatFCount = int(header->flatFCount);
+  const int* flatFOffsets = reader.array<int>(flatFCount + 1);
+  const qint64 flatFPointCount = flatFOffsets ? flatFOffsets[flatFCount] : 0;
+  const float* flatFXs = reader.array<float>(flatFPointCount);
+  const float* flatFYs = reader.array<float>(flatFPointCount);
+  if (!validOffsets(flatOffsets, flatCount, flatPointCount) || !flatXs ||
+      !flatYs || !validOffsets(flatFOffsets, flatFCount, flatFPointCount) ||
+      !flatFXs || !flatFYs) {
+    return false;
+  }
+  data->flatPointsView =
+      SvgPointsView<qreal>(flatXs, flatYs, flatOffsets, flatCount);
+  data->flatPointsFView =
+      SvgPointsView<float>(flatFXs, flatFYs, flatFOffsets, flatFCount);
+  data->cacheMapping = file;  // Keeps the mapping alive with the document
+
+  const int symbolCount = int(header->symbolPathCount);
+  const int instanceCount = int(header->instanceCount);
+  if (!readPaths(reader, symbolCount, data->symbolPathList) ||
+      !readPointLists(reader, int(header->symbolPointListCount),
+                      data->symbolPointList)) {
+    return false;
+  }
+  const qint32* shapes = reader.array<qint32>(instanceCount);
+  const qint32* indexes = reader.array<qint32>(instanceCount);
+  const double* transforms = reader.array<double>(qint64(instanceCount) * 6);
+  if (!shapes || !indexes || !transforms) {
+    return false;
+  }
+  // Every kept output holds the same parsed shapes, and the instances go
+  // between them in increasing order; see mergeInstances()
+  QVector<int> parsedCounts;
+  if (parseOutputs.testFlag(PathOutput)) {
+    parsedCounts.append(int(header->pathCount));
+  }
+  if (parseOutputs.testFlag(PointOutput)) {
+    parsedCounts.append(int(header->pointListCount));
+  }
+  if (parseOutputs.testFlag(FlatPointOutput)) {
+    parsedCounts.append(parseOutputs.testFlag(FloatPoints) ? flatFCount
+                                                           : flatCount);
+  }
+  for (int count : parsedCounts) {
+    if (count != parsedCounts.first()) {
+      return false;
+    }
+  }
+  const qint64 shapeCount =
+      qint64(parsedCounts.value(0)) + qint64(instanceCount);
+  data->instances.reserve(instanceCount);
+  for (int i = 0; i < instanceCount; ++i) {
+    const qint64 firstIndex = i > 0 ? qint64(indexes[i - 1]) + 1 : 0;
+    if (shapes[i] < 0 || shapes[i] >= symbolCount ||
+        indexes[i] < firstIndex || indexes[i] >= shapeCount) {
+      return false;
+    }
+    const double* m = transforms + i * 6;
+    data->instances.append(
+        {shapes[i], QTransform(m[0], m[1], m[2], m[3], m[4], m[5]),
+         indexes[i]});
+  }
+
+  // Fingerprints for incremental parsing; shape numbers are -1 for elements
+  // that drew nothing, see reuseShape()
+  const int elementCount = int(header->elementCount);
+  const quint64* elementHashes = reader.array<quint64>(elementCount);
+  const qint32* elementShapes = reader.array<qint32>(elementCount);
+  if (!elementHashes || !elementShapes) {
+    return false;
+  }
+  for (int i = 0; i < elementCount; ++i) {
+    if (elementShapes[i] < -1 ||
+        (!parsedCounts.isEmpty() && elementShapes[i] >= parsedCounts.first())) {
+      return false;
+    }
+  }
+  data->elementHashes.resize(elementCount);
+  data->elementShapes.resize(elementCount);
+  if (elementCount > 0) {
+    memcpy(data->elementHashes.data(), elementHashes,
+           elementCount * sizeof(quint64));
+    memcpy(data->elementShapes.data(), elementShapes,
+           elementCount * sizeof(qint32));
+  }
+
+  document.d = data;
+  return true;
+}
+
+void SvgHelper::saveCache(const QString& cachePath,
+                          const SvgDocument& document, qint64 sourceSize,
+                          qint64 sourceModified) const {
+  // Called on freshly parsed documents, so the lists hold only the parsed
+  // shapes and the instances are stored as such
+  const SvgDocument::Data& data = *document.d;
+  const auto unchanged = [&] {
+    const QFileInfo source(data.filepath);
+    return source.size() == sourceSize &&
+           source.lastModified().toMSecsSinceEpoch() == sourceModified;
+  };
+  // Checked again after hashing, which reads the file once more
+  if (!unchanged()) {
+    return;
+  }
+  const QByteArray sourceHash = fileHash(data.filepath);
+  if (!unchanged()) {
+    return;
+  }
+  const QByteArray sourcePath =
+      QFileInfo(data.filepath).absoluteFilePath().toUtf8();
+  const QByteArray aspectRatio = data.preserveAspectRatio.toUtf8();
+
+  CacheHeader header;
+  memset(&header, 0, sizeof(header));  // Padding included
+  memcpy(header.magic, kCacheMagic, 8);
+  header.version = kCacheVersion;
+  header.byteOrder = kCacheByteOrder;
+  header.qrealSize = sizeof(qreal);
+  header.sourcePathSize = quint32(sourcePath.size());
+  header.sourceSize = sourceSize;
+  header.sourceModified = sourceModified;
+  memcpy(header.sourceHash, sourceHash.constData(), 20);
+  header.outputs = quint32(parseOutputs);
+  header.samplingMode = quint32(samplingPolicy.mode);
+  header.samplingValue = samplingPolicy.value;
+  header.applyTransforms = applyTransforms;
+  header.resolveUses = resolveUses;
+  header.parseMode = parseMode;
+  header.aspectRatioSize = quint32(aspectRatio.size());
+  header.elementsRecorded = incrementalParse;
+  header.elementCount = quint32(data.elementHashes.size());
+  header.simplifyTolerance = simplifyTolerance;
+  header.pointListPending = data.pointListPending;
+  header.width = data.defaultSize.width();
+  header.height = data.defaultSize.height();
+  header.viewBox[0] = data.viewBox.x();
+  header.viewBox[1] = data.viewBox.y();
+  header.viewBox[2] = data.viewBox.width();
+  header.viewBox[3] = data.viewBox.height();
+  header.pathCount = quint32(data.svgPathList.size());
+  // A pending point list is left out and filled again after loading
+  const QList<QList<QPointF>> pointLists =
+      data.pointListPending ? QList<QList<QPointF>>() : data.svgPointList;
+  header.pointListCount = quint32(pointLists.size());
+  header.flatCount = quint32(data.flatPointsView.shapeCount());
+  header.flatFCount = quint32(data.flatPointsFView.shapeCount());
+  header.symbolPathCount = quint32(data.symbolPathList.size());
+  header.symbolPointListCount = quint32(data.symbolPointList.size());
+  header.instanceCount = quint32(data.instances.size());
+
+  QSaveFile file(cachePath);
+  if (!QDir().mkpath(QFileInfo(cachePath).absolutePath()) ||
+      !file.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to write SVG cache:" << cachePath;
+    return;
+  }
+  CacheWriter writer(&file);
+  writer.write(&header, sizeof(header));
+  writer.write(sourcePath.constData(), sourcePath.size());
+  writer.write(aspectRatio.constData(), aspectRatio.size());
+  writePaths(writer, data.svgPathList);
+  writePointLists(writer, pointLists);
+
+  static const int kNoShapes = 0;  // Offsets of a view that was never set
+  const SvgPointsView<qreal>& flat = data.flatPointsView;
+  writer.writeArray(flat.offsetData() ? flat.offsetData() : &kNoShapes,
+                    flat.shapeCount() + 1);
+  writer.writeArray(flat.xData(), flat.pointCount());
+  writer.writeArray(flat.yData(), flat.pointCount());
+  const SvgPointsView<float>& flatF = data.flatPointsFView;
+  writer.writeArray(flatF.offsetData() ? flatF.offsetData() : &kNoShapes,
+                    flatF.shapeCount() + 1);
+  writer.writeArray(flatF.xData(), flatF.pointCount());
+  writer.writeArray(flatF.yData(), flatF.pointCount());
+
+  writePaths(writer, data.symbolPathList);
+  writePointLists(writer, data.symbolPointList);
+  QVector<qint32> shapes;
+  QVector<qint32> indexes;
+  QVector<double> transforms;
+  for (const SvgInstance& instance : data.instances) {
+    const QTransform& m = instance.transform;
+    shapes.append(instance.shape);
+    indexes.append(instance.index);
+    transforms << m.m11() << m.m12() << m.m21() << m.m22() << m.dx() << m.dy();
+  }
+  writer.writeArray(shapes.constData(), shapes.size());
+  writer.writeArray(indexes.constData(), indexes.size());
+  writer.writeArray(transforms.constData(), transforms.size());
+  writer.writeArray(data.elementHashes.constData(),
+                    data.elementHashes.size());
+  writer.writeArray(data.elementShapes.constData(),
+                    data.elementShapes.size());
+
+  if (!writer.ok || !file.commit()) {
+    qWarning() << "Failed to write SVG cache:" << cachePath;
+  }
+}
 
- private:
-  void parseSVGTag(QDomElement e, QString tagname);
-  void parseSvgPath(const QString& path, QPainterPath& paintPath);
-  void dealParsePainter(QPainterPath& path, QString line);
-  QVector<float> segmentationCoordinates(QString value);
-  float getValueWithoutUnit(QString input);
-  double radian(double ux, double uy, double vx, double vy);
-  int svgArcToCenterParam(double x1, double y1, double rx, double ry,
-                          double phi, double fA, double fS, double x2,
-                          double y2, double& cx_out, double& cy_out,
-                          double& startAngle_out, double& deltaAngle_out);
-  double getAngleWithPoints(double x1, double y1, double x2, double y2,
-                            double x3, double y3);
+SvgDocument SvgHelper::getDocument() const {
+  return document;
+}
 
-  QString filepath;
-  QPainterPath paintPath;
-  QList<QPointF> testpathlist;
-  QPointF nowPositon = QPointF(0, 0);
-  QPointF pathStartPosition = QPointF(0, 0);
-  QPointF lastControlPosition = QPointF(0, 0);
-  QList<QPainterPath> svgPathList;
-  QList<QList<QPointF>> svgPointList;
-};
+QList<SvgHelper> SvgHelper::parseSvgBatch(const QStringList& filepaths,
+                                          int maxThreadCount) const {
+  // The files already run in parallel, so each one is parsed sequentially
+  SvgHelper settings = settingsCopy();
+  settings.threadCount = 1;
 
-// --- Implementation ---
+  // Fill the list before handing out pointers so no task sees it reallocate
+  QList<SvgHelper> results;
+  results.reserve(filepaths.size());
+  for (int i = 0; i < filepaths.size(); ++i) {
+    results.append(settings);
+  }
 
-namespace {  // Anonymous namespace for internal linkage
+  QThreadPool pool;
+  if (maxThreadCount > 0) {
+    pool.setMaxThreadCount(maxThreadCount);
+  }
+  for (int i = 0; i < filepaths.size(); ++i) {
+    SvgHelper* helper = &results[i];
+    const QString path = filepaths.at(i);
+    pool.start(new FunctionTask([helper, path] { helper->parseSvg(path); }));
+  }
+  pool.waitForDone();
+  return results;
+}
 
-const QList<QChar> kCmdList = {'M', 'm', 'L', 'l', 'H', 'h', 'V',
-                               'v', 'C', 'c', 'S', 's', 'Q', 'q',
-                               'T', 't', 'A', 'a', 'Z', 'z'};
-const QList<QChar> kCmdkTypeList = {'M', 'L', 'H', 'V', 'C',
-                                    'S', 'Q', 'T', 'A', 'Z'};
-const QList<QChar> kSplitList = {' ',  '-',  ',',
-                                 '\r', '\n', '\t'};  // Added \n explicitly
-const QList<QString> kUnitList = {"em", "px", "%",  "cm",
-                                  "mm", "in", "pt", "pc"};
-const QList<QString> kTypeList = {"path", "rect",    "circle",  "ellipse",
-                                  "line", "polygon", "polyline"};
+void SvgHelper::parseSvgStream(QIODevice* device,
+                               ParseContext& context) const {
+  // Every element is visited exactly once and nothing but the current
+  // element's attributes is kept, so memory does not grow with file size.
+  QXmlStreamReader reader(device);
+  for (;;) {
+    const QXmlStreamReader::TokenType token = reader.readNext();
+    if (token == QXmlStreamReader::StartElement) {
+      if (context.stopRequested()) {
+        break;
+      }
+      startElement(reader.name(), reader.attributes(), context);
+    } else if (token == QXmlStreamReader::EndElement) {
+      endElement(context);
+    } else if (reader.atEnd()) {
+      // A sequential device that ran dry mid-document: the next readNext()
+      // resumes where the reader stopped once more data has arrived
+      if (reader.error() != QXmlStreamReader::PrematureEndOfDocumentError ||
+          !waitForMoreData(device, [&] { return context.stopRequested(); })) {
+        break;
+      }
+    }
+  }
+  if (reader.hasError() && context.status == SvgDocument::Complete) {
+    qWarning() << "Failed to parse SVG content from file:" << context.filepath
+               << ":" << reader.errorString();
+  }
+}
 
-#define ABSOLUTE_COORDINATES 1
-#define RELATIVE_COORDINATES 2
+void SvgHelper::startElement(QStringView name,
+                             const QXmlStreamAttributes& attributes,
+                             ParseContext& context) const {
+  QVector<QTransform>& transforms = context.transformStack;
+  const QTransform parent =
+      transforms.isEmpty() ? QTransform() : transforms.last();
+  if (!context.rootSeen && name == QLatin1String("svg")) {
+    readRootElement(attributes, context);
+    if (context.applyTransforms) {
+      transforms.append(context.rootTransform);
+    }
+  } else if (context.applyTransforms) {
+    transforms.append(
+        parseTransform(attributeValue(attributes, "transform")) * parent);
+  }
+  if (context.applyTransforms) {
+    context.currentTransform = transforms.last();
+  }
+  ++context.elementDepth;
 
-// Helper function to get SVG size
-QSize matchSize(const QString& path) {
-  QSvgRenderer renderer(path);
-  if (renderer.isValid()) {
-    QSize size = renderer.defaultSize();
-    QRect viewBox = renderer.viewBox();
-    // Often defaultSize already reflects viewBox, but check if viewBox is more explicit
-    // if (viewBox.isValid() && !viewBox.isEmpty() && viewBox.size() != size) {
-    //     size = viewBox.size(); // Use viewBox size if different and valid
-    // }
-    if (size.isValid() && !size.isEmpty()) {
-      return size;
+  if (context.resolveUses) {
+    const bool symbol = name == QLatin1String("symbol");
+    if (context.definitionDepth == 0 &&
+        (symbol || name == QLatin1String("defs"))) {
+      context.definitionDepth = context.elementDepth;
+    }
+    const QStringView id = attributeValue(attributes, "id");
+    if (context.definitionDepth > 0 && !id.isEmpty()) {
+      Definition definition;
+      definition.id = id.toString();
+      definition.depth = context.elementDepth;
+      definition.begin = int(context.definitionParts.size());
+      definition.parentInverse = parent.inverted();
+      if (symbol) {
+        QVector<float> box;
+        segmentationCoordinates(attributeValue(attributes, "viewBox"), box);
+        if (box.size() == 4 && box[2] > 0 && box[3] > 0) {
+          definition.viewBox = QRectF(box[0], box[1], box[2], box[3]);
+        }
+        definition.preserveAspectRatio =
+            attributeValue(attributes, "preserveAspectRatio").toString();
+      }
+      context.openDefinitions.append(definition);
     }
   }
-  qWarning() << "Could not determine valid size for SVG:" << path
-             << ". Using default 100x100.";
-  return QSize(100, 100);
+
+  const int typeIndex = shapeTypeIndex(name);
+  if (typeIndex >= 0) {
+    visitElement(attributes, kTypeList.at(typeIndex), context);
+  } else if (context.resolveUses && name == QStringView(kUseTag)) {
+    visitElement(attributes, kUseTag, context);
+  }
 }
 
-}  // namespace
+void SvgHelper::endElement(ParseContext& context) const {
+  if (!context.transformStack.isEmpty()) {
+    context.transformStack.removeLast();
+  }
+  if (!context.openDefinitions.isEmpty() &&
+      context.openDefinitions.last().depth == context.elementDepth) {
+    Definition definition = context.openDefinitions.takeLast();
+    definition.end = int(context.definitionParts.size());
+    context.definitions.insert(definition.id, definition);
+  }
+  if (context.definitionDepth == context.elementDepth) {
+    context.definitionDepth = 0;
+  }
+  --context.elementDepth;
+}
 
-void SvgHelper::parseSvg(const QString& filepath) {
-  this->filepath = filepath;
-  // Clear previous data
-  svgPathList.clear();
-  svgPointList.clear();
+void SvgHelper::readRootElement(const QXmlStreamAttributes& attributes,
+                                ParseContext& context) const {
+  context.rootSeen = true;
+  QVector<float> box;
+  segmentationCoordinates(attributeValue(attributes, "viewBox"), box);
+  if (box.size() == 4 && box[2] > 0 && box[3] > 0) {
+    context.viewBox = QRectF(box[0], box[1], box[2], box[3]);
+  }
+  context.preserveAspectRatio =
+      attributeValue(attributes, "preserveAspectRatio").toString();
+  qreal width = rootLength(attributeValue(attributes, "width"));
+  qreal height = rootLength(attributeValue(attributes, "height"));
+  if (width < 0) {
+    width = context.viewBox.width();
+  }
+  if (height < 0) {
+    height = context.viewBox.height();
+  }
+  if (width > 0 && height > 0) {
+    context.defaultSize = QSizeF(width, height).toSize();
+    if (context.applyTransforms && !context.viewBox.isEmpty()) {
+      context.rootTransform = viewBoxTransform(
+          context.viewBox, QSizeF(width, height), context.preserveAspectRatio);
+    }
+  }
+}
 
-  QFile svgFile(filepath);
-  if (svgFile.open(QFile::ReadOnly)) {
-    QDomDocument doc;
-    if (doc.setContent(&svgFile)) {
-      svgFile.close();
-      QDomElement root = doc.documentElement();
-      QDomNode node = root.firstChild();
-      while (!node.isNull()) {
-        if (node.isElement()) {
-          QDomElement e = node.toElement();
-          QString tagname = e.tagName();
-          if (kTypeList.contains(tagname)) {
-            parseSVGTag(e, tagname);
-          } else {
-            // Search for nested elements of interest
-            foreach (const QString& type, kTypeList) {
-              QDomNodeList list = e.elementsByTagName(type);
-              for (int i = 0; i < list.count(); i++) {
-                QDomNode n = list.at(i);
-                if (n.isElement()) {  // Extra check for safety
-                  parseSVGTag(n.toElement(), n.nodeName());
+void SvgHelper::parseSvgDom(QIODevice* device, ParseContext& context) const {
+  // The DOM needs the whole document, so collect a sequential device's data
+  // up to its end first
+  QByteArray content = device->readAll();
+  while (waitForMoreData(device, [&] { return context.stopRequested(); })) {
+    content += device->readAll();
+  }
+  if (context.stopRequested()) {
+    return;
+  }
+  QDomDocument doc;
+  if (doc.setContent(content)) {
+    QDomElement root = doc.documentElement();
+    if (context.resolveUses) {
+      // Definitions and uses need the elements in document order with
+      // their nesting, as the stream parser sees them
+      walkDomElement(root, context);
+      return;
+    }
+    if (root.tagName() == QLatin1String("svg")) {
+      readRootElement(domAttributes(root), context);
+    }
+    QDomNode node = root.firstChild();
+    while (!node.isNull() && !context.stopRequested()) {
+      if (node.isElement()) {
+        QDomElement e = node.toElement();
+        QString tagname = e.tagName();
+        if (kTypeList.contains(tagname)) {
+          if (context.applyTransforms) {
+            context.currentTransform =
+                elementTransform(e, context.rootTransform);
+          }
+          visitElement(domAttributes(e), tagname, context);
+        } else {
+          // Search for nested elements of interest
+          foreach (const QString& type, kTypeList) {
+            QDomNodeList list = e.elementsByTagName(type);
+            for (int i = 0; i < list.count() && !context.stopRequested();
+                 i++) {
+              QDomNode n = list.at(i);
+              if (n.isElement()) {  // Extra check for safety
+                if (context.applyTransforms) {
+                  context.currentTransform =
+                      elementTransform(n.toElement(), context.rootTransform);
                 }
+                visitElement(domAttributes(n.toElement()), n.nodeName(),
+                             context);
               }
             }
           }
         }
-        node = node.nextSibling();
       }
+      node = node.nextSibling();
+    }
+  } else {
+    qWarning() << "Failed to parse SVG content from file:" << context.filepath;
+  }
+}
+
+void SvgHelper::walkDomElement(const QDomElement& element,
+                               ParseContext& context) const {
+  if (context.stopRequested()) {
+    return;
+  }
+  const QString tagname = element.tagName();
+  startElement(tagname, domAttributes(element), context);
+  for (QDomElement child = element.firstChildElement(); !child.isNull();
+       child = child.nextSiblingElement()) {
+    walkDomElement(child, context);
+  }
+  endElement(context);
+}
+
+void SvgHelper::visitElement(const QXmlStreamAttributes& attributes,
+                             const QString& tagname,
+                             ParseContext& context) const {
+  if (context.stopRequested()) {
+    return;
+  }
+  if (++context.elementsSeen % kProgressInterval == 0) {
+    // Elements collected for parallel parsing are not done yet
+    reportProgress(context,
+                   context.elementsSeen - int(context.pendingElements.size()));
+  }
+  if (context.collectStats) {
+    ++context.stats.elementCounts[tagname];
+  }
+  // QXmlStreamAttributes own their strings, so they outlive the reader
+  ElementRecord element{tagname, attributes, context.currentTransform};
+  element.definition = context.definitionDepth > 0;
+  // Definitions and uses are not shapes of their own; definitions are
+  // parsed right away so the symbol lists stay in document order
+  const bool shape = !element.definition && tagname != kUseTag;
+  if (context.recordElements && shape) {
+    element.fingerprint = elementFingerprint(tagname, attributes);
+    if (context.applyTransforms) {
+      // The same element under other groups maps to another shape
+      element.fingerprint =
+          fingerprintAppend(element.fingerprint, element.transform);
+    }
+    const auto it = context.previousShapes.constFind(element.fingerprint);
+    if (it != context.previousShapes.constEnd()) {
+      element.reused = true;
+      element.previousShape = it.value();
+      element.attributes.clear();  // Not needed any more
+    }
+  }
+  if (threadCount == 1 || shapeVisitor || element.definition) {
+    parseElement(element, context);
+  } else {
+    context.pendingElements.append(element);
+  }
+}
+
+void SvgHelper::parseElement(const ElementRecord& element,
+                             ParseContext& context) const {
+  if (element.tagname == kUseTag) {
+    addUse(element, context);
+    return;
+  }
+  int shape = -1;
+  if (element.reused) {
+    if (element.previousShape >= 0) {
+      reuseShape(element.previousShape, context);
+      shape = context.shapeCount++;
+    }
+  } else {
+    QElapsedTimer timer;
+    if (context.collectStats) {
+      timer.start();
+    }
+    // Symbol shapes keep their own coordinates, instances add the rest
+    parseSVGTag(element.attributes, element.tagname,
+                element.definition ? QTransform() : element.transform,
+                context);
+    if (context.collectStats) {
+      context.shapeNs += timer.nsecsElapsed();
+      if (!context.paintPath.isEmpty()) {
+        context.stats.pointCount += context.testpathlist.size();
+      }
+    }
+    if (element.definition) {
+      if (!context.paintPath.isEmpty()) {
+        DefinitionPart part;
+        part.shape = int(context.symbolPathList.size());
+        part.transform = element.transform;
+        context.definitionParts.append(part);
+        context.symbolPathList.append(context.paintPath);
+        if (context.samplePoints) {
+          context.symbolPointList.append(context.testpathlist);
+        }
+      }
+      return;
+    }
+    if (!context.paintPath.isEmpty()) {
+      storeShape(context);
+      shape = context.shapeCount++;
+      if (shapeVisitor) {
+        const SvgShapeVisitor::ElementInfo info{
+            element.tagname, element.attributes, context.elementCount, shape};
+        shapeVisitor->onPath(context.paintPath, context.testpathlist, info);
+      }
+    }
+  }
+  ++context.elementCount;
+  if (context.recordElements) {
+    context.elementHashes.append(element.fingerprint);
+    context.elementShapes.append(shape);
+  }
+}
+
+void SvgHelper::reportProgress(const ParseContext& context,
+                               int elements) const {
+  if (!progressCallback) {
+    return;
+  }
+  const bool sequential = context.device->isSequential();
+  progressCallback(elements,
+                   sequential ? -1 : context.device->pos(),
+                   sequential ? -1 : context.device->size());
+}
+
+void SvgHelper::reuseShape(int shape, ParseContext& context) const {
+  const SvgDocument::Data& previous = *context.previous.d;
+  // The previous lists hold its instances too, expanded by parseDevice()
+  shape = flatShapeIndex(previous.instances, shape);
+  if (context.outputs.testFlag(PathOutput)) {
+    context.svgPathList.append(previous.svgPathList.at(shape));
+  }
+  if (context.outputs.testFlag(PointOutput)) {
+    context.svgPointList.append(previous.svgPointList.at(shape));
+  }
+  if (context.outputs.testFlag(FlatPointOutput)) {
+    if (context.outputs.testFlag(FloatPoints)) {
+      context.flatPointsF.appendShape(previous.flatPointsFView.shape(shape));
+    } else {
+      context.flatPoints.appendShape(previous.flatPointsView.shape(shape));
+    }
+  }
+}
+
+void SvgHelper::storeShape(ParseContext& context) const {
+  if (context.outputs.testFlag(PathOutput)) {
+    context.svgPathList.append(context.paintPath);
+  }
+  if (context.outputs.testFlag(PointOutput)) {
+    context.svgPointList.append(context.testpathlist);
+  }
+  if (context.outputs.testFlag(FlatPointOutput)) {
+    if (context.outputs.testFlag(FloatPoints)) {
+      context.flatPointsF.appendShape(context.testpathlist,
+                                      context.pointTransform);
     } else {
-      qWarning() << "Failed to parse SVG content from file:" << filepath;
+      context.flatPoints.appendShape(context.testpathlist,
+                                     context.pointTransform);
     }
+  }
+}
+
+void SvgHelper::addUse(const ElementRecord& element,
+                       ParseContext& context) const {
+  const QXmlStreamAttributes& attributes = element.attributes;
+  QStringView href = attributeValue(attributes, "href");
+  if (href.isEmpty()) {
+    href = attributeValue(attributes, "xlink:href");
+  }
+  if (!href.startsWith(QLatin1Char('#'))) {
+    return;  // Only references into this document
+  }
+  DefinitionPart use;
+  use.href = href.mid(1).toString();
+  const float x = getValueWithoutUnit(attributeValue(attributes, "x", u"0"));
+  const float y = getValueWithoutUnit(attributeValue(attributes, "y", u"0"));
+  use.transform = QTransform::fromTranslate(x, y) * element.transform;
+  const QStringView width = attributeValue(attributes, "width");
+  const QStringView height = attributeValue(attributes, "height");
+  if (!width.isEmpty() && !height.isEmpty()) {
+    use.size = QSizeF(getValueWithoutUnit(width), getValueWithoutUnit(height));
+  }
+  if (element.definition) {
+    context.definitionParts.append(use);
   } else {
-    qWarning() << "Failed to open SVG file for reading:" << filepath;
+    use.position = context.shapeCount;
+    context.uses.append(use);
+  }
+}
+
+void SvgHelper::resolveInstances(ParseContext& context) const {
+  // Runs once the whole document is read, so uses may precede their
+  // definitions
+  QStringList chain;
+  for (const DefinitionPart& use : context.uses) {
+    instantiate(use, QTransform(), use.position, chain, context);
+  }
+  if (context.symbolPointList.isEmpty()) {
+    return;
+  }
+  // Symbol points were sampled in the symbol's units; sample again the
+  // shapes an instance scales up, for the largest scale among them
+  QVector<qreal> scales(context.symbolPathList.size(), 1);
+  for (const SvgInstance& instance : context.instances) {
+    qreal& scale = scales[instance.shape];
+    scale = qMax(scale, transformScale(instance.transform));
+  }
+  for (int i = 0; i < scales.size(); ++i) {
+    if (scales.at(i) > 1) {
+      QList<QPointF>& points = context.symbolPointList[i];
+      points.clear();
+      flattenPainterPath(context.symbolPathList.at(i),
+                         scaledPolicy(samplingPolicy, scales.at(i)), points);
+      if (simplifyTolerance > 0) {
+        simplifyPoints(points, simplifyTolerance / scales.at(i),
+                       context.simplifyRanges, context.simplifyKeep);
+      }
+    }
+  }
+}
+
+void SvgHelper::instantiate(const DefinitionPart& use,
+                            const QTransform& outer, int position,
+                            QStringList& chain, ParseContext& context) const {
+  // Unknown ids and references back into the chain draw nothing
+  const auto it = context.definitions.constFind(use.href);
+  if (it == context.definitions.constEnd() || chain.contains(use.href)) {
+    return;
+  }
+  chain.append(use.href);
+  const Definition& definition = it.value();
+  QTransform transform = definition.parentInverse;
+  if (context.applyTransforms && !definition.viewBox.isEmpty() &&
+      !use.size.isEmpty()) {
+    transform *= viewBoxTransform(definition.viewBox, use.size,
+                                  definition.preserveAspectRatio);
+  }
+  transform *= use.transform * outer;
+  for (int i = definition.begin; i < definition.end; ++i) {
+    const DefinitionPart& part = context.definitionParts.at(i);
+    if (part.shape >= 0) {
+      const int index = position + int(context.instances.size());
+      context.instances.append({part.shape, part.transform * transform, index});
+    } else {
+      instantiate(part, transform, position, chain, context);
+    }
+  }
+  chain.removeLast();
+}
+
+void SvgHelper::parseElementsParallel(ParseContext& context) const {
+  if (context.pendingElements.isEmpty()) {
+    return;
+  }
+  const QVector<ElementRecord> elements = std::move(context.pendingElements);
+  context.pendingElements.clear();
+
+  const int threads =
+      threadCount > 0 ? threadCount : QThread::idealThreadCount();
+  const int elementCount = int(elements.size());
+  const int parsedBefore = context.elementsSeen - elementCount;
+  const int chunkCount =
+      qBound(1, elementCount / kMinElementsPerThread, threads * 4);
+  if (chunkCount == 1) {
+    for (int i = 0; i < elementCount && !context.stopRequested(); ++i) {
+      parseElement(elements.at(i), context);
+      if ((i + 1) % kProgressInterval == 0) {
+        reportProgress(context, parsedBefore + i + 1);
+      }
+    }
+    return;
+  }
+
+  // Contiguous chunks with their own contexts; each element starts from a
+  // clean cursor, so the split does not change the result
+  QVector<ParseContext> workers(chunkCount);
+  std::atomic<int> parsed(0);
+  QThreadPool pool;
+  pool.setMaxThreadCount(threads);
+  for (int chunk = 0; chunk < chunkCount; ++chunk) {
+    ParseContext* worker = &workers[chunk];
+    worker->filepath = context.filepath;
+    worker->outputs = context.outputs;
+    worker->samplePoints = context.samplePoints;
+    worker->recordElements = context.recordElements;
+    worker->previous = context.previous;
+    worker->cancelToken = context.cancelToken;
+    worker->deadline = context.deadline;
+    worker->collectStats = context.collectStats;
+    const int begin = int(qint64(elementCount) * chunk / chunkCount);
+    const int end = int(qint64(elementCount) * (chunk + 1) / chunkCount);
+    pool.start(new FunctionTask([this, worker, &elements, &parsed, begin,
+                                 end] {
+      for (int i = begin; i < end && !worker->stopRequested(); ++i) {
+        parseElement(elements.at(i), *worker);
+        parsed.fetch_add(1, std::memory_order_relaxed);
+      }
+    }));
+  }
+  // Report from this thread while the workers run, so the callback stays
+  // on the parsing thread
+  while (!pool.waitForDone(kProgressPollMs)) {
+    reportProgress(context, parsedBefore + parsed.load());
+  }
+
+  for (const ParseContext& worker : workers) {
+    context.svgPathList.append(worker.svgPathList);
+    context.svgPointList.append(worker.svgPointList);
+    context.flatPoints.append(worker.flatPoints);
+    context.flatPointsF.append(worker.flatPointsF);
+    context.elementHashes += worker.elementHashes;
+    for (DefinitionPart use : worker.uses) {
+      use.position += context.shapeCount;
+      context.uses.append(use);
+    }
+    for (int shape : worker.elementShapes) {
+      context.elementShapes.append(shape < 0 ? shape
+                                             : context.shapeCount + shape);
+    }
+    context.shapeCount += worker.shapeCount;
+    context.shapeNs += worker.shapeNs;
+    mergeStats(context.stats, worker.stats);
+    // Keep the results a prefix of the document; later chunks may have
+    // finished, but the elements between them were not parsed
+    if (worker.status != SvgDocument::Complete) {
+      context.status = worker.status;
+      break;
+    }
   }
 }
 
-QImage SvgHelper::getSvgImage() {
-  QSize imagesize = matchSize(filepath);
-  if (imagesize.isEmpty() || imagesize.width() <= 0 ||
-      imagesize.height() <= 0) {
-    qWarning() << "Invalid SVG size detected for" << filepath
+QImage SvgHelper::getSvgImage() const {
+  return getSvgImage(1.0);
+}
+
+QImage SvgHelper::getSvgImage(qreal scale) const {
+  QSize imagesize = document.getSize();
+  if (imagesize.isEmpty()) {
+    qWarning() << "Invalid SVG size detected for" << document.getFilepath()
                << ", using default 100x100";
     imagesize = QSize(100, 100);
   }
+  return getSvgImage((QSizeF(imagesize) * scale).toSize());
+}
 
-  QImage image(imagesize, QImage::Format_ARGB32);
+QImage SvgHelper::getSvgImage(const QSize& size) const {
+  QImage image(size, QImage::Format_ARGB32);
   image.fill(Qt::white);  // Fill with white background
+  if (!renderSvgImage(image)) {
+    return QImage();  // Return null image on failure
+  }
+  return image;
+}
 
+bool SvgHelper::renderSvgImage(QImage& image) const {
+  QElapsedTimer timer;
+  if (collectStats) {
+    timer.start();
+  }
   QPainter p(&image);
   if (!p.isActive()) {
     qCritical() << "Failed to activate QPainter on QImage";
-    return QImage();  // Return null image on failure
+    return false;
   }
   p.setRenderHint(QPainter::Antialiasing, true);  // Often useful for SVGs
   p.setPen(Qt::black);
+  p.setTransform(imageTransform(image.size()));
 
-  foreach (const QPainterPath& ppath, svgPathList) {
+  foreach (const QPainterPath& ppath, document.getSvgPathList()) {
     p.drawPath(ppath);
   }
-  // p.end() is called automatically by QPainter destructor
-  return image;
+  p.end();
+  if (collectStats) {
+    document.d->renderNs = timer.nsecsElapsed();
+  }
+  return true;
+}
+
+bool SvgHelper::renderSvgImageTiled(QImage& image, const QSize& tileSize,
+                                    int maxThreadCount) const {
+  // Tiles are views into image's pixels, which needs whole bytes per pixel
+  if (image.isNull() || image.depth() < 8 || tileSize.isEmpty()) {
+    return renderSvgImage(image);
+  }
+  QElapsedTimer timer;
+  if (collectStats) {
+    timer.start();
+  }
+
+  const QTransform transform = imageTransform(image.size());
+  const QTransform inverse = transform.inverted();
+  // Built here so the tiles only read the paths and their index
+  const QList<QPainterPath>& paths = document.getSvgPathList();
+  document.ensureSpatialIndex();
+  // Room around each tile for the 1 unit pen and antialiasing
+  const qreal margin =
+      0.5 * qMax(qAbs(transform.m11()), qAbs(transform.m22())) + 1;
+
+  uchar* const bits = image.bits();  // Detach once, before any tile runs
+  const qsizetype bytesPerLine = image.bytesPerLine();
+  const int bytesPerPixel = image.depth() / 8;
+  const QImage::Format format = image.format();
+
+  std::atomic<bool> failed(false);
+  QThreadPool pool;
+  if (maxThreadCount > 0) {
+    pool.setMaxThreadCount(maxThreadCount);
+  }
+  for (int y = 0; y < image.height(); y += tileSize.height()) {
+    for (int x = 0; x < image.width(); x += tileSize.width()) {
+      const QRect tileRect = QRect(x, y, tileSize.width(), tileSize.height())
+                                 .intersected(image.rect());
+      pool.start(new FunctionTask([&, tileRect] {
+        QImage tile(bits + tileRect.y() * bytesPerLine +
+                        tileRect.x() * bytesPerPixel,
+                    tileRect.width(), tileRect.height(), bytesPerLine,
+                    format);
+        QPainter p(&tile);
+        if (!p.isActive()) {
+          failed = true;
+          return;
+        }
+        p.setRenderHint(QPainter::Antialiasing, true);
+        p.setPen(Qt::black);
+        p.setTransform(transform *
+                       QTransform::fromTranslate(-tileRect.x(), -tileRect.y()));
+        // Drawing a path fills a converter cache in its shared data, so
+        // each tile draws copies of its own
+        const QRectF area = inverse.mapRect(
+            QRectF(tileRect).adjusted(-margin, -margin, margin, margin));
+        for (int i : document.pathsInRect(area)) {
+          p.drawPath(detachedPath(paths.at(i)));
+        }
+      }));
+    }
+  }
+  pool.waitForDone();
+
+  if (failed) {
+    qCritical() << "Failed to activate QPainter on QImage";
+    return false;
+  }
+  if (collectStats) {
+    document.d->renderNs = timer.nsecsElapsed();
+  }
+  return true;
+}
+
+QTransform SvgHelper::imageTransform(const QSize& imageSize) const {
+  // Stretch the document's area over the whole image, and map the viewBox
+  // into that area the way parsing with transforms applied does. With
+  // transforms applied the coordinates are already in document pixels.
+  QSizeF size(document.getSize());
+  const QRectF viewBox =
+      document.d->transformsApplied ? QRectF() : document.getViewBox();
+  if (size.isEmpty()) {
+    size = viewBox.size();
+  }
+  QTransform transform;
+  if (!size.isEmpty()) {
+    if (!viewBox.isEmpty()) {
+      transform = viewBoxTransform(viewBox, size,
+                                   document.d->preserveAspectRatio);
+    }
+    transform *= QTransform::fromScale(imageSize.width() / size.width(),
+                                       imageSize.height() / size.height());
+  }
+  return transform;
 }
 
-void SvgHelper::parseSVGTag(QDomElement e, QString tagname) {
-  // Clear data for this specific tag
-  paintPath.clear();
-  testpathlist.clear();
+void SvgHelper::parseSVGTag(const QXmlStreamAttributes& attributes,
+                            const QString& tagname,
+                            const QTransform& transform,
+                            ParseContext& context) const {
+  // Clear data for this specific tag. Path data starts over at the origin,
+  // so a leading relative "m" never depends on the previous element.
+  context.paintPath.clear();
+  context.testpathlist.clear();
+  context.nowPositon = QPointF(0, 0);
+  context.pathStartPosition = QPointF(0, 0);
+  context.lastControlPosition = QPointF(0, 0);
+  context.samplingPolicy =
+      scaledPolicy(samplingPolicy, transformScale(transform));
 
   if (QString::compare(tagname, "path", Qt::CaseInsensitive) == 0) {
-    QString pathvalue = e.attribute("d");
-    parseSvgPath(pathvalue, paintPath);
+    QStringView pathvalue = attributeValue(attributes, "d");
+    parseSvgPath(pathvalue, context);
 
   } else if (QString::compare(tagname, "rect", Qt::CaseInsensitive) == 0) {
     // Default values if attributes are missing
-    float x = getValueWithoutUnit(e.attribute("x", "0"));
-    float y = getValueWithoutUnit(e.attribute("y", "0"));
-    float width = getValueWithoutUnit(e.attribute("width"));
-    float height = getValueWithoutUnit(e.attribute("height"));
+    float x = getValueWithoutUnit(attributeValue(attributes, "x", u"0"));
+    float y = getValueWithoutUnit(attributeValue(attributes, "y", u"0"));
+    float width = getValueWithoutUnit(attributeValue(attributes, "width"));
+    float height = getValueWithoutUnit(attributeValue(attributes, "height"));
     // rx/ry default to -1 to indicate "not specified"
-    float rx = getValueWithoutUnit(e.attribute("rx", "-1"));
-    float ry =
-        getValueWithoutUnit(e.attribute("ry", "-1"));  // Corrected from "rx"
+    float rx = getValueWithoutUnit(attributeValue(attributes, "rx", u"-1"));
+    float ry = getValueWithoutUnit(
+        attributeValue(attributes, "ry", u"-1"));  // Corrected from "rx"
 
     // Handle invalid dimensions
     if (width <= 0 || height <= 0) {
@@ -204,174 +3351,170 @@ void SvgHelper::parseSVGTag(QDomElement e, QString tagname) {
     rx = qMin(rx, width / 2.0f);
     ry = qMin(ry, height / 2.0f);
 
-    QList<QPointF> pointsForList;
-
     if (rx <= 0 && ry <= 0) {
       // Sharp corners rectangle
-      paintPath.addRect(x, y, width, height);
+      context.paintPath.addRect(x, y, width, height);
       // Add points for rect
-      pointsForList.append(QPointF(x, y));
-      pointsForList.append(QPointF(x + width, y));
-      pointsForList.append(QPointF(x + width, y + height));
-      pointsForList.append(QPointF(x, y + height));
-      pointsForList.append(QPointF(x, y));  // Close
+      context.addPoint(QPointF(x, y));
+      context.addPoint(QPointF(x + width, y));
+      context.addPoint(QPointF(x + width, y + height));
+      context.addPoint(QPointF(x, y + height));
+      context.addPoint(QPointF(x, y));  // Close
 
     } else {
       // Rounded rectangle using QPainterPath::addRoundedRect
-      paintPath.addRoundedRect(QRectF(x, y, width, height), rx, ry);
-      // Approximate points for rounded rect (more complex to get exact arc points)
-      QPainterPath tempPath;
-      tempPath.addRoundedRect(QRectF(x, y, width, height), rx, ry);
-      // Sample points along the path
-      const int numSamples =
-          qMax(20, static_cast<int>(tempPath.length() / 2.0));  // Heuristic
-      for (int i = 0; i <= numSamples; ++i) {
-        qreal percent = static_cast<qreal>(i) / numSamples;
-        pointsForList.append(tempPath.pointAtPercent(percent));
-      }
-      // Ensure the list closes properly if needed by your logic
-      if (!pointsForList.isEmpty()) {
-        pointsForList.append(pointsForList.first());
+      context.paintPath.addRoundedRect(QRectF(x, y, width, height), rx, ry);
+      if (context.samplePoints) {
+        flattenRoundedRect(QRectF(x, y, width, height), rx, ry,
+                           context.samplingPolicy, context.testpathlist);
       }
     }
-    svgPointList.append(pointsForList);
 
   } else if (QString::compare(tagname, "circle", Qt::CaseInsensitive) == 0) {
-    float cx = getValueWithoutUnit(e.attribute("cx", "0"));
-    float cy = getValueWithoutUnit(e.attribute("cy", "0"));
-    float r = getValueWithoutUnit(e.attribute("r"));
+    float cx = getValueWithoutUnit(attributeValue(attributes, "cx", u"0"));
+    float cy = getValueWithoutUnit(attributeValue(attributes, "cy", u"0"));
+    float r = getValueWithoutUnit(attributeValue(attributes, "r"));
 
-    QList<QPointF> pointsForList;
     if (r > 0) {
-      paintPath.addEllipse(QPointF(cx, cy), r, r);
-      // Add points for circle
-      QPainterPath tempPath;
-      tempPath.addEllipse(QPointF(cx, cy), r, r);
-      const int numSamples = 36;  // Or based on path length
-      for (int i = 0; i <= numSamples; ++i) {
-        qreal percent = static_cast<qreal>(i) / numSamples;
-        pointsForList.append(tempPath.pointAtPercent(percent));
-      }
-      // Ensure the list closes properly if needed by your logic
-      if (!pointsForList.isEmpty()) {
-        pointsForList.append(pointsForList.first());
-      }
-      svgPointList.append(pointsForList);
+      context.paintPath.addEllipse(QPointF(cx, cy), r, r);
+      if (context.samplePoints) {
+        flattenEllipse(QPointF(cx, cy), r, r, context.samplingPolicy,
+                       context.testpathlist);
+      }
     } else {
       qWarning() << "Circle with invalid radius r=" << r;
     }
 
   } else if (QString::compare(tagname, "ellipse", Qt::CaseInsensitive) == 0) {
-    float cx = getValueWithoutUnit(e.attribute("cx", "0"));
-    float cy = getValueWithoutUnit(e.attribute("cy", "0"));
-    float rx = getValueWithoutUnit(e.attribute("rx"));
-    float ry = getValueWithoutUnit(e.attribute("ry"));
+    float cx = getValueWithoutUnit(attributeValue(attributes, "cx", u"0"));
+    float cy = getValueWithoutUnit(attributeValue(attributes, "cy", u"0"));
+    float rx = getValueWithoutUnit(attributeValue(attributes, "rx"));
+    float ry = getValueWithoutUnit(attributeValue(attributes, "ry"));
 
-    QList<QPointF> pointsForList;
     if (rx > 0 && ry > 0) {
-      paintPath.addEllipse(QPointF(cx, cy), rx, ry);
-      // Add points for ellipse
-      QPainterPath tempPath;
-      tempPath.addEllipse(QPointF(cx, cy), rx, ry);
-      const int numSamples = 36;  // Or based on path length
-      for (int i = 0; i <= numSamples; ++i) {
-        qreal percent = static_cast<qreal>(i) / numSamples;
-        pointsForList.append(tempPath.pointAtPercent(percent));
-      }
-      // Ensure the list closes properly if needed by your logic
-      if (!pointsForList.isEmpty()) {
-        pointsForList.append(pointsForList.first());
-      }
-      svgPointList.append(pointsForList);
+      context.paintPath.addEllipse(QPointF(cx, cy), rx, ry);
+      if (context.samplePoints) {
+        flattenEllipse(QPointF(cx, cy), rx, ry, context.samplingPolicy,
+                       context.testpathlist);
+      }
     } else {
       qWarning() << "Ellipse with invalid radii rx=" << rx << ", ry=" << ry;
     }
 
   } else if (QString::compare(tagname, "line", Qt::CaseInsensitive) == 0) {
-    float x1 = getValueWithoutUnit(e.attribute("x1", "0"));
-    float y1 = getValueWithoutUnit(e.attribute("y1", "0"));
-    float x2 = getValueWithoutUnit(e.attribute("x2", "0"));
-    float y2 = getValueWithoutUnit(e.attribute("y2", "0"));
+    float x1 = getValueWithoutUnit(attributeValue(attributes, "x1", u"0"));
+    float y1 = getValueWithoutUnit(attributeValue(attributes, "y1", u"0"));
+    float x2 = getValueWithoutUnit(attributeValue(attributes, "x2", u"0"));
+    float y2 = getValueWithoutUnit(attributeValue(attributes, "y2", u"0"));
 
-    paintPath.moveTo(x1, y1);
-    paintPath.lineTo(x2, y2);
+    context.paintPath.moveTo(x1, y1);
+    context.paintPath.lineTo(x2, y2);
     // Add points for line
-    QList<QPointF> pointsForList;
-    pointsForList.append(QPointF(x1, y1));
-    pointsForList.append(QPointF(x2, y2));
-    svgPointList.append(pointsForList);
+    context.addPoint(QPointF(x1, y1));
+    context.addPoint(QPointF(x2, y2));
 
   } else if (QString::compare(tagname, "polygon", Qt::CaseInsensitive) == 0 ||
              QString::compare(tagname, "polyline", Qt::CaseInsensitive) == 0) {
-    QString value = e.attribute("points");
-    QVector<float> vPos = segmentationCoordinates(value);
-    QList<QPointF> pointsForList;
+    QStringView value = attributeValue(attributes, "points");
+    QVector<float>& vPos = context.coordinates;
+    QElapsedTimer timer;
+    if (context.collectStats) {
+      timer.start();
+    }
+    segmentationCoordinates(value, vPos);
+    if (context.collectStats) {
+      context.stats.tokenizeNs += timer.nsecsElapsed();
+    }
 
     if (vPos.size() >= 2) {
       QPointF startPoint(vPos[0], vPos[1]);
-      paintPath.moveTo(startPoint);
-      pointsForList.append(startPoint);
+      context.paintPath.moveTo(startPoint);
+      context.addPoint(startPoint);
 
       for (int i = 2; i < vPos.size() - 1; i += 2) {
         QPointF point(vPos[i], vPos[i + 1]);
-        paintPath.lineTo(point);
-        pointsForList.append(point);
+        context.paintPath.lineTo(point);
+        context.addPoint(point);
       }
 
-      if (QString::compare(tagname, "polygon", Qt::CaseInsensitive) == 0 &&
-          !pointsForList.isEmpty()) {
-        paintPath.closeSubpath();  // Connect last point to first for polygon
-        pointsForList.append(startPoint);  // Add start point to close the list
-      } else if (!pointsForList.isEmpty()) {
+      if (QString::compare(tagname, "polygon", Qt::CaseInsensitive) == 0) {
+        // Connect last point to first for polygon
+        context.paintPath.closeSubpath();
+        context.addPoint(startPoint);  // Add start point to close the list
+      } else {
         // For polyline, just ensure the path ends at the last point
         // The path already does this implicitly with lineTo calls.
         // QPainterPath keeps track of the current point.
       }
-      svgPointList.append(pointsForList);
     } else {
       qWarning() << "Insufficient points for" << tagname << ":" << value;
     }
   }
 
-  // Add the constructed path to the main list if it's not empty
-  if (!paintPath.isEmpty()) {
-    svgPathList.append(paintPath);
+  // Finish a non-empty shape. parseElement() stores it, or adds it to the
+  // symbol lists; path and points together, so the lists stay index-aligned.
+  if (!context.paintPath.isEmpty()) {
+    context.pointTransform = QTransform();
+    if (!transform.isIdentity()) {
+      context.paintPath = transform.map(context.paintPath);
+      // Nothing reads the points before they are stored when only the
+      // flat lists keep them
+      if (!context.outputs.testFlag(PointOutput) && !shapeVisitor &&
+          simplifyTolerance <= 0) {
+        context.pointTransform = transform;
+      } else {
+        transformPoints(context.testpathlist, transform);
+      }
+    }
+    if (simplifyTolerance > 0) {
+      simplifyPoints(context.testpathlist, simplifyTolerance,
+                     context.simplifyRanges, context.simplifyKeep);
+    }
   }
   // Note: paintPath and testpathlist are cleared at the beginning of the function
   // or will be cleared for the next tag. No need to clear here explicitly.
 }
 
-void SvgHelper::parseSvgPath(const QString& path, QPainterPath& paintPath) {
-  QString cmdLine = "";
-  for (QChar c : path) {  // Use range-based loop for clarity
-    if (kCmdList.contains(c)) {
-      if (!cmdLine.isEmpty()) {
-        dealParsePainter(paintPath, cmdLine);
-        cmdLine.clear();
+void SvgHelper::parseSvgPath(QStringView path, ParseContext& context) const {
+  SvgPathLexer lexer(path);
+  QVector<float>& operands = context.operands;  // Reused for every command
+  QElapsedTimer timer;
+  if (context.collectStats) {
+    timer.start();
+  }
+  QChar cmd;
+  while (lexer.nextCommand(cmd)) {
+    operands.clear();
+    const bool isArc = cmd == 'A' || cmd == 'a';
+    float value;
+    for (;;) {
+      // The large-arc and sweep flags are operands 4 and 5 of each arc
+      const int arcIndex = operands.size() % 7;
+      const bool isFlag = isArc && (arcIndex == 3 || arcIndex == 4);
+      if (!(isFlag ? lexer.nextFlag(value) : lexer.nextNumber(value))) {
+        break;
       }
+      operands.append(value);
+    }
+    if (context.collectStats) {
+      context.stats.tokenizeNs += timer.nsecsElapsed();
+      ++context.stats.commandCounts[cmd];
+      dealParsePainter(cmd, operands, context);
+      timer.start();
+    } else {
+      dealParsePainter(cmd, operands, context);
     }
-    cmdLine += c;
   }
-  if (!cmdLine.isEmpty()) {
-    dealParsePainter(paintPath, cmdLine);
-    cmdLine.clear();
+  if (context.collectStats) {
+    context.stats.tokenizeNs += timer.nsecsElapsed();
   }
 }
 
-void SvgHelper::dealParsePainter(QPainterPath& path, QString line) {
-  line = line.trimmed();
-  if (line.isEmpty())
-    return;  // Safety check
-
-  QString cmdStr = line.mid(0, 1);
-  QString valueStr = line.mid(1).trimmed();  // Trim value part as well
-
-  if (cmdStr.isEmpty())
-    return;  // Should not happen after checks, but safe
-
-  QChar cmd = cmdStr.at(0);
+void SvgHelper::dealParsePainter(QChar cmd, const QVector<float>& operands,
+                                 ParseContext& context) const {
+  QPainterPath& path = context.paintPath;
   bool isAbsolute = cmd.isUpper();
-  int coordinates = isAbsolute ? ABSOLUTE_COORDINATES : RELATIVE_COORDINATES;
+  OperandCursor vNum(operands);
 
   // Find command type index (case-insensitive)
   int cmdIndex = kCmdkTypeList.indexOf(cmd.toUpper());
@@ -380,80 +3523,78 @@ void SvgHelper::dealParsePainter(QPainterPath& path, QString line) {
     return;
   }
 
-  QVector<float> vNum = segmentationCoordinates(valueStr);
-
   switch (cmdIndex) {
     case 0: {  // M/m - moveto
-      bool hasLineFlag = vNum.length() > 2;
+      bool hasLineFlag = vNum.has(3);
       bool lineto = false;
-      while (vNum.length() >= 2) {
+      while (vNum.has(2)) {
         QPointF point(vNum[0], vNum[1]);
         if (isAbsolute) {
-          nowPositon = point;
+          context.nowPositon = point;
         } else {
-          nowPositon += point;
+          context.nowPositon += point;
         }
 
         if (!lineto) {
-          path.moveTo(nowPositon);
-          pathStartPosition =
-              nowPositon;  // Set start position for potential 'Z'
-          testpathlist.append(nowPositon);
+          path.moveTo(context.nowPositon);
+          context.pathStartPosition =
+              context.nowPositon;  // Set start position for potential 'Z'
+          context.addPoint(context.nowPositon);
         } else {
-          path.lineTo(nowPositon);
-          testpathlist.append(nowPositon);
+          path.lineTo(context.nowPositon);
+          context.addPoint(context.nowPositon);
         }
 
-        vNum.remove(0, 2);
+        vNum.advance(2);
         lineto = true;  // Subsequent pairs are implicit linetos
       }
       break;
     }
     case 1: {  // L/l - lineto
-      while (vNum.length() >= 2) {
+      while (vNum.has(2)) {
         QPointF point(vNum[0], vNum[1]);
         if (isAbsolute) {
-          nowPositon = point;
+          context.nowPositon = point;
         } else {
-          nowPositon += point;
+          context.nowPositon += point;
         }
-        path.lineTo(nowPositon);
-        testpathlist.append(nowPositon);
+        path.lineTo(context.nowPositon);
+        context.addPoint(context.nowPositon);
         // QPainterPath automatically sets current point, no need for explicit moveTo
-        vNum.remove(0, 2);
+        vNum.advance(2);
       }
       break;
     }
     case 2: {  // H/h - horizontal lineto
-      while (!vNum.isEmpty()) {
+      while (vNum.has(1)) {
         float x = vNum[0];
         if (isAbsolute) {
-          nowPositon.setX(x);
+          context.nowPositon.setX(x);
         } else {
-          nowPositon.rx() += x;  // rx() returns a reference
+          context.nowPositon.rx() += x;  // rx() returns a reference
         }
-        path.lineTo(nowPositon);
-        testpathlist.append(nowPositon);
-        vNum.remove(0, 1);
+        path.lineTo(context.nowPositon);
+        context.addPoint(context.nowPositon);
+        vNum.advance(1);
       }
       break;
     }
     case 3: {  // V/v - vertical lineto
-      while (!vNum.isEmpty()) {
+      while (vNum.has(1)) {
         float y = vNum[0];
         if (isAbsolute) {
-          nowPositon.setY(y);
+          context.nowPositon.setY(y);
         } else {
-          nowPositon.ry() += y;
+          context.nowPositon.ry() += y;
         }
-        path.lineTo(nowPositon);
-        testpathlist.append(nowPositon);
-        vNum.remove(0, 1);
+        path.lineTo(context.nowPositon);
+        context.addPoint(context.nowPositon);
+        vNum.advance(1);
       }
       break;
     }
     case 4: {  // C/c - cubic bezier curveto
-      while (vNum.length() >= 6) {
+      while (vNum.has(6)) {
         QPointF c1(vNum[0], vNum[1]);
         QPointF c2(vNum[2], vNum[3]);
         QPointF endPoint(vNum[4], vNum[5]);
@@ -462,132 +3603,116 @@ void SvgHelper::dealParsePainter(QPainterPath& path, QString line) {
           // c1, c2, endPoint are already absolute
         } else {
           // Convert relative coordinates to absolute
-          c1 += nowPositon;
-          c2 += nowPositon;
-          endPoint += nowPositon;
+          c1 += context.nowPositon;
+          c2 += context.nowPositon;
+          endPoint += context.nowPositon;
         }
 
+        const QPointF startPoint = context.nowPositon;
         path.cubicTo(c1, c2, endPoint);
-        lastControlPosition = c2;  // Store last control point for potential 'S'
-        nowPositon = endPoint;     // Update current position
-
-        // Sample points for testpathlist (approximation)
-        QPainterPath tempSegment;
-        tempSegment.moveTo(nowPositon);  // Start from current position
-        tempSegment.cubicTo(c1, c2, endPoint);
-        const int numSamples =
-            qMax(5, static_cast<int>(tempSegment.length() / 2.0));
-        for (int i = 0; i <= numSamples; ++i) {
-          qreal percent = static_cast<qreal>(i) / numSamples;
-          testpathlist.append(tempSegment.pointAtPercent(percent));
+        // Store last control point for potential 'S'
+        context.lastControlPosition = c2;
+        context.nowPositon = endPoint;  // Update current position
+
+        if (context.samplePoints) {
+          flattenCubic(startPoint, c1, c2, endPoint, context.samplingPolicy,
+                       context.testpathlist);
         }
 
-        vNum.remove(0, 6);
+        vNum.advance(6);
       }
       break;
     }
     case 5: {  // S/s - smooth cubic bezier curveto
-      while (vNum.length() >= 4) {
+      while (vNum.has(4)) {
         QPointF c2(vNum[0], vNum[1]);
         QPointF endPoint(vNum[2], vNum[3]);
 
         // Reflect previous control point (if available, otherwise use current point)
-        QPointF c1 = (lastControlPosition == QPointF(0, 0))
-                         ? nowPositon
-                         : (2 * nowPositon) - lastControlPosition;
+        QPointF c1 =
+            (context.lastControlPosition == QPointF(0, 0))
+                ? context.nowPositon
+                : (2 * context.nowPositon) - context.lastControlPosition;
 
         if (isAbsolute) {
-          c2 = c2;  // Already absolute
+          // c2, endPoint are already absolute
         } else {
-          c2 += nowPositon;
+          c2 += context.nowPositon;
+          endPoint += context.nowPositon;
         }
 
+        const QPointF startPoint = context.nowPositon;
         path.cubicTo(c1, c2, endPoint);
-        lastControlPosition = c2;
-        nowPositon = endPoint;
-
-        // Sample points (approximation)
-        QPainterPath tempSegment;
-        tempSegment.moveTo(nowPositon);  // Start from current position
-        tempSegment.cubicTo(c1, c2, endPoint);
-        const int numSamples =
-            qMax(5, static_cast<int>(tempSegment.length() / 2.0));
-        for (int i = 0; i <= numSamples; ++i) {
-          qreal percent = static_cast<qreal>(i) / numSamples;
-          testpathlist.append(tempSegment.pointAtPercent(percent));
+        context.lastControlPosition = c2;
+        context.nowPositon = endPoint;
+
+        if (context.samplePoints) {
+          flattenCubic(startPoint, c1, c2, endPoint, context.samplingPolicy,
+                       context.testpathlist);
         }
 
-        vNum.remove(0, 4);
+        vNum.advance(4);
       }
       break;
     }
     case 6: {  // Q/q - quadratic bezier curveto
-      while (vNum.length() >= 4) {
+      while (vNum.has(4)) {
         QPointF cPoint(vNum[0], vNum[1]);
         QPointF endPoint(vNum[2], vNum[3]);
 
         if (isAbsolute) {
           // cPoint, endPoint are already absolute
         } else {
-          cPoint += nowPositon;
-          endPoint += nowPositon;
+          cPoint += context.nowPositon;
+          endPoint += context.nowPositon;
         }
 
+        const QPointF startPoint = context.nowPositon;
         path.quadTo(cPoint, endPoint);
-        lastControlPosition = cPoint;  // Store for potential 'T'
-        nowPositon = endPoint;
-
-        // Sample points (approximation)
-        QPainterPath tempSegment;
-        tempSegment.moveTo(nowPositon);  // Start from current position
-        tempSegment.quadTo(cPoint, endPoint);
-        const int numSamples =
-            qMax(5, static_cast<int>(tempSegment.length() / 2.0));
-        for (int i = 0; i <= numSamples; ++i) {
-          qreal percent = static_cast<qreal>(i) / numSamples;
-          testpathlist.append(tempSegment.pointAtPercent(percent));
+        context.lastControlPosition = cPoint;  // Store for potential 'T'
+        context.nowPositon = endPoint;
+
+        if (context.samplePoints) {
+          flattenQuad(startPoint, cPoint, endPoint, context.samplingPolicy,
+                      context.testpathlist);
         }
 
-        vNum.remove(0, 4);
+        vNum.advance(4);
       }
       break;
     }
     case 7: {  // T/t - smooth quadratic bezier curveto
-      while (vNum.length() >= 2) {
+      while (vNum.has(2)) {
         QPointF endPoint(vNum[0], vNum[1]);
 
         // Reflect previous control point (if available, otherwise use current point)
-        QPointF cPoint = (lastControlPosition == QPointF(0, 0))
-                             ? nowPositon
-                             : (2 * nowPositon) - lastControlPosition;
+        QPointF cPoint =
+            (context.lastControlPosition == QPointF(0, 0))
+                ? context.nowPositon
+                : (2 * context.nowPositon) - context.lastControlPosition;
 
         if (isAbsolute) {
           endPoint = endPoint;  // Already absolute
         } else {
-          endPoint += nowPositon;
+          endPoint += context.nowPositon;
         }
 
+        const QPointF startPoint = context.nowPositon;
         path.quadTo(cPoint, endPoint);
-        lastControlPosition = cPoint;
-        nowPositon = endPoint;
-
-        // Sample points (approximation)
-        QPainterPath tempSegment;
-        tempSegment.moveTo(nowPositon);  // Start from current position
-        tempSegment.quadTo(cPoint, endPoint);
-        const int numSamples =
-            qMax(5, static_cast<int>(tempSegment.length() / 2.0));
-        for (int i = 0; i <= numSamples; ++i) {
-          qreal percent = static_cast<qreal>(i) / numSamples;
-          testpathlist.append(tempSegment.pointAtPercent(percent));
+        context.lastControlPosition = cPoint;
+        context.nowPositon = endPoint;
+
+        if (context.samplePoints) {
+          flattenQuad(startPoint, cPoint, endPoint, context.samplingPolicy,
+                      context.testpathlist);
         }
 
-        vNum.remove(0, 2);
+        vNum.advance(2);
       }
       break;
     }
     case 8: {  // A/a - elliptical arc
-      while (vNum.length() >= 7) {
+      while (vNum.has(7)) {
         float rx = vNum[0];
         float ry = vNum[1];
         float x_axis_rotation = vNum[2];
@@ -598,135 +3723,87 @@ void SvgHelper::dealParsePainter(QPainterPath& path, QString line) {
         if (isAbsolute) {
           // endPoint is already absolute
         } else {
-          endPoint += nowPositon;
+          endPoint += context.nowPositon;
         }
 
         if (rx <= 0 || ry <= 0) {
           // SVG spec: If rx or ry is 0, treat as line
           path.lineTo(endPoint);
-          testpathlist.append(nowPositon);
-          testpathlist.append(endPoint);
-          nowPositon = endPoint;
-          vNum.remove(0, 7);
+          context.addPoint(context.nowPositon);
+          context.addPoint(endPoint);
+          context.nowPositon = endPoint;
+          vNum.advance(7);
           continue;
         }
 
+        // Radii that cannot reach endPoint are scaled up in place
+        double arcRx = rx;
+        double arcRy = ry;
         double cx, cy, start_angle, delta_angle;
-        int result = svgArcToCenterParam(nowPositon.x(), nowPositon.y(), rx, ry,
-                                         x_axis_rotation, large_arc_flag,
-                                         sweep_flag, endPoint.x(), endPoint.y(),
-                                         cx, cy, start_angle, delta_angle);
+        int result = svgArcToCenterParam(
+            context.nowPositon.x(), context.nowPositon.y(), arcRx, arcRy,
+            x_axis_rotation, large_arc_flag, sweep_flag, endPoint.x(),
+            endPoint.y(), cx, cy, start_angle, delta_angle);
 
         if (result == 1) {  // Success
-          start_angle = qRadiansToDegrees(start_angle);
-          delta_angle = qRadiansToDegrees(delta_angle);
-          QRectF rect(cx - rx, cy - ry, 2 * rx, 2 * ry);
           if (delta_angle != 0) {
-            // QPainterPath::arcTo draws counter-clockwise from startAngle for angleSpan.
-            // SVG sweep_flag determines direction.
-            // We need to adjust angles based on the coordinate system difference.
-            double qtStartAngle = -start_angle;
-            double qtSpanAngle = -delta_angle;
-            if (sweep_flag ==
-                0) {  // If sweep flag is 0 (counter-clockwise), negate the span
-              qtSpanAngle = -qtSpanAngle;
-            }
-
-            path.arcTo(rect, qtStartAngle, qtSpanAngle);
-
-            // Sample points along the arc for testpathlist
-            QPainterPath tempArcPath;
-            tempArcPath.arcMoveTo(rect, qtStartAngle);  // Move to start
-            tempArcPath.arcTo(rect, qtStartAngle, qtSpanAngle);
-            const int numSamples =
-                qMax(5, static_cast<int>(tempArcPath.length() / 2.0));
-            for (int i = 0; i <= numSamples; ++i) {
-              qreal percent = static_cast<qreal>(i) / numSamples;
-              testpathlist.append(tempArcPath.pointAtPercent(percent));
+            const EllipseArc arc(QPointF(cx, cy), arcRx, arcRy,
+                                 x_axis_rotation, start_angle, delta_angle);
+            arc.appendTo(path);
+            if (context.samplePoints) {
+              arc.flatten(context.samplingPolicy, context.testpathlist);
             }
           }
         } else {
           // Fallback if arc calculation fails
           path.lineTo(endPoint);
-          testpathlist.append(nowPositon);
-          testpathlist.append(endPoint);
+          context.addPoint(context.nowPositon);
+          context.addPoint(endPoint);
           qWarning() << "Arc calculation failed for A/a command";
         }
 
-        nowPositon = endPoint;
-        vNum.remove(0, 7);
+        context.nowPositon = endPoint;
+        vNum.advance(7);
       }
       break;
     }
     case 9: {  // Z/z - closepath
       path.closeSubpath();  // This automatically draws a line back to the start of the current subpath
-      testpathlist.append(
+      context.addPoint(
           path.currentPosition());  // Append the point it closed to (start of subpath)
       // Note: QPainterPath handles the start position internally for Z command.
       // If you need the explicit start point for your logic, you might need to track it differently.
       // The provided `pathStartPosition` is an attempt, but might not be perfect for complex paths.
       // path.lineTo(pathStartPosition); // Alternative, but closeSubpath is preferred.
-      // testpathlist.append(pathStartPosition);
+      // addPoint(pathStartPosition);
       break;
     }
   }
 }
 
-QVector<float> SvgHelper::segmentationCoordinates(QString value) {
-  // 将科学记数法暂时替换, 防止分割出错
-  if (value.contains("e", Qt::CaseInsensitive)) {
-    value.replace("e-", "[KXJSFF]");
-    value.replace("E-", "[KXJSFF]");
-  }
-  if (value.contains(" -")) {
-    value.replace(" -", " [KGFS]");
-  }
-  if (value.contains(",-")) {
-    value.replace(",-", ",[DHFS]");
-  }
-  QVector<float> vPos;
-  QString num = "";
-  foreach (QChar c, value) {
-    if (kSplitList.contains(c)) {
-      num = num.trimmed();
-      if (!num.isEmpty()) {
-        if (num.contains(','))
-          num.remove(',');
-        vPos.append(getValueWithoutUnit(num));
-        num.clear();
-      }
+void SvgHelper::segmentationCoordinates(QStringView value,
+                                        QVector<float>& out) const {
+  out.clear();  // Keeps the capacity of earlier calls
+  SvgPathLexer lexer(value);
+  float num;
+  while (!lexer.atEnd()) {
+    if (lexer.nextNumber(num)) {
+      out.append(num);
+    } else {
+      lexer.skipChar();  // Ignore anything that is not a number
     }
-    num += c;
   }
-  num = num.trimmed();
-  if (num.contains(','))
-    num.remove(',');
-  if (!num.isEmpty())
-    vPos.append(getValueWithoutUnit(num));
-  return vPos;
 }
 
-float SvgHelper::getValueWithoutUnit(QString input) {
-  // 将科学记数法替换回来
-  if (input.contains("[KXJSFF]"))
-    input.replace("[KXJSFF]", "e-");
-  if (input.contains("[KGFS]"))
-    input.replace("[KGFS]", "-");
-  if (input.contains("[DHFS]"))
-    input.replace("[DHFS]", "-");
+float SvgHelper::getValueWithoutUnit(QStringView input) const {
+  input = input.trimmed();
   if (input.isEmpty())
     return -1;
-  QString str = input;
-  foreach (QString unit, kUnitList) {
-    if (str.contains(
-            unit, Qt::CaseInsensitive)) {  // Make unit removal case-insensitive
-      str.remove(unit);
-    }
-  }
-  bool ok;
-  float result = str.toFloat(&ok);
-  if (!ok) {
-    // qDebug() << "Failed to convert string to float:" << str;
+  // The unit (px, mm, %, ...) trails the number and is simply not consumed
+  SvgPathLexer lexer(input);
+  float result;
+  if (!lexer.nextNumber(result)) {
+    // qDebug() << "Failed to convert string to float:" << input;
     return 0.0f;  // Or another default/error value if -1 is ambiguous
   }
   return result;
@@ -742,8 +3819,9 @@ x-axis-rotation 椭圆弧X轴方向的旋转角度
 large-arc-flag 标记是否大弧段
 sweep-flag 标记是否顺时针绘制
 sample :  svgArcToCenterParam(200,200,50,50,0,1,1,300,200, output...)
+rx/ry 不足以连接两端点时会按规范就地放大
 */
-double SvgHelper::radian(double ux, double uy, double vx, double vy) {
+double SvgHelper::radian(double ux, double uy, double vx, double vy) const {
   double dot = ux * vx + uy * vy;
   double mod = sqrt((ux * ux + uy * uy) * (vx * vx + vy * vy));
   if (mod == 0.0)
@@ -754,11 +3832,12 @@ double SvgHelper::radian(double ux, double uy, double vx, double vy) {
   return rad;
 }
 
-int SvgHelper::svgArcToCenterParam(double x1, double y1, double rx, double ry,
-                                   double phi, double fA, double fS, double x2,
-                                   double y2, double& cx_out, double& cy_out,
+int SvgHelper::svgArcToCenterParam(double x1, double y1, double& rx,
+                                   double& ry, double phi, double fA,
+                                   double fS, double x2, double y2,
+                                   double& cx_out, double& cy_out,
                                    double& startAngle_out,
-                                   double& deltaAngle_out) {
+                                   double& deltaAngle_out) const {
   double cx, cy, startAngle, deltaAngle;
   const double PIx2 = 2.0 * M_PI;
 
@@ -838,7 +3917,7 @@ int SvgHelper::svgArcToCenterParam(double x1, double y1, double rx, double ry,
 }
 
 double SvgHelper::getAngleWithPoints(double x1, double y1, double x2, double y2,
-                                     double x3, double y3) {
+                                     double x3, double y3) const {
   // This function seems unused in the provided code, but kept for completeness.
   double theta = atan2(x1 - x3, y1 - y3) - atan2(x2 - x3, y2 - y3);
   if (theta > M_PI)
@@ -852,12 +3931,183 @@ double SvgHelper::getAngleWithPoints(double x1, double y1, double x2, double y2,
   return theta;
 }
 
-QList<QList<QPointF>> SvgHelper::getSvgPointList() const {
-  return svgPointList;
+const QList<QList<QPointF>>& SvgHelper::getSvgPointList() const {
+  return document.getSvgPointList();
+}
+
+const QList<QPainterPath>& SvgHelper::getSvgPathList() const {
+  return document.getSvgPathList();
+}
+
+SvgHelper::Results SvgHelper::takeResults() {
+  SvgDocument taken = std::move(document);
+  document = SvgDocument();
+  taken.getSvgPointList();  // Fill a pending point list first
+
+  Results results;
+  if (taken.d.use_count() == 1) {
+    // Sole owner, and the data was allocated non-const by parseDocument()
+    SvgDocument::Data& data = const_cast<SvgDocument::Data&>(*taken.d);
+    results.svgPathList = std::move(data.svgPathList);
+    results.svgPointList = std::move(data.svgPointList);
+  } else {
+    results.svgPathList = taken.getSvgPathList();
+    results.svgPointList = taken.getSvgPointList();
+  }
+  return results;
+}
+
+SvgDocument::SvgDocument() : d(std::make_shared<Data>()) {}
+
+SvgDocument::ParseStatus SvgDocument::getParseStatus() const {
+  return d->status;
+}
+
+SvgParseStats SvgDocument::getParseStats() const {
+  SvgParseStats stats = d->stats;
+  stats.renderNs = d->renderNs;
+  return stats;
+}
+
+QString SvgDocument::getFilepath() const {
+  return d->filepath;
+}
+
+const QList<QPainterPath>& SvgDocument::getSvgPathList() const {
+  ensureInstances();
+  return d->svgPathList;
+}
+
+QSize SvgDocument::getSize() const {
+  return d->defaultSize;
+}
+
+QRectF SvgDocument::getViewBox() const {
+  return d->viewBox;
+}
+
+const QVector<QRectF>& SvgDocument::getPathBounds() const {
+  ensureInstances();
+  std::call_once(d->pathBoundsOnce, [this] {
+    d->pathBounds.reserve(d->svgPathList.size());
+    for (const QPainterPath& path : d->svgPathList) {
+      path.controlPointRect();  // Fill the path's own cache as well
+      d->pathBounds.append(path.boundingRect());
+    }
+  });
+  return d->pathBounds;
+}
+
+void SvgDocument::ensureSpatialIndex() const {
+  const QVector<QRectF>& bounds = getPathBounds();
+  std::call_once(d->spatialIndexOnce,
+                 [this, &bounds] { d->spatialIndex.build(bounds); });
+}
+
+QVector<int> SvgDocument::pathsInRect(const QRectF& rect) const {
+  ensureSpatialIndex();
+  return d->spatialIndex.query(rect, d->pathBounds);
+}
+
+int SvgDocument::nearestPath(const QPointF& point, qreal maxDistance) const {
+  ensureSpatialIndex();
+  const QVector<QRectF>& bounds = d->pathBounds;
+  const QList<QList<QPointF>>& points = getSvgPointList();
+  const bool hasPoints = points.size() == bounds.size();
+  return d->spatialIndex.nearest(point, maxDistance, bounds, [&](int i) {
+    if (!hasPoints || points.at(i).isEmpty()) {
+      return rectDistance(point, bounds.at(i));
+    }
+    return polylineDistance(point, points.at(i));
+  });
+}
+
+SvgPointsView<qreal> SvgDocument::getFlatPointList() const {
+  ensureInstances();
+  return d->flatPointsView;
+}
+
+SvgPointsView<float> SvgDocument::getFlatPointListF() const {
+  ensureInstances();
+  return d->flatPointsFView;
+}
+
+const QList<QPainterPath>& SvgDocument::getSymbolPathList() const {
+  return d->symbolPathList;
+}
+
+const QList<QList<QPointF>>& SvgDocument::getSymbolPointList() const {
+  return d->symbolPointList;
+}
+
+const QVector<SvgInstance>& SvgDocument::getInstances() const {
+  return d->instances;
+}
+
+void SvgDocument::ensureInstances() const {
+  if (d->instances.isEmpty()) {
+    return;
+  }
+  // Each list is rebuilt with the instance shapes at their indexes. A
+  // pending point list is flattened from the merged paths later.
+  std::call_once(d->instancesOnce, [this] {
+    const QVector<SvgInstance>& instances = d->instances;
+    if (d->outputs.testFlag(SvgHelper::PathOutput)) {
+      QList<QPainterPath> paths;
+      paths.reserve(d->svgPathList.size() + instances.size());
+      mergeInstances(
+          int(d->svgPathList.size()), instances,
+          [&](int shape) { paths.append(d->svgPathList.at(shape)); },
+          [&](const SvgInstance& instance) {
+            paths.append(
+                instance.transform.map(d->symbolPathList.at(instance.shape)));
+          });
+      d->svgPathList = std::move(paths);
+    }
+    if (d->outputs.testFlag(SvgHelper::PointOutput)) {
+      QList<QList<QPointF>> pointLists;
+      pointLists.reserve(d->svgPointList.size() + instances.size());
+      mergeInstances(
+          int(d->svgPointList.size()), instances,
+          [&](int shape) { pointLists.append(d->svgPointList.at(shape)); },
+          [&](const SvgInstance& instance) {
+            pointLists.append(instancePoints(d->symbolPointList, instance));
+          });
+      d->svgPointList = std::move(pointLists);
+    }
+    if (d->outputs.testFlag(SvgHelper::FlatPointOutput)) {
+      // The views may point into the cache mapping, so read from them
+      if (d->outputs.testFlag(SvgHelper::FloatPoints)) {
+        d->flatPointsF = mergeFlatInstances(d->flatPointsFView,
+                                            d->symbolPointList, instances);
+        d->flatPointsFView = d->flatPointsF.view();
+      } else {
+        d->flatPoints = mergeFlatInstances(d->flatPointsView,
+                                           d->symbolPointList, instances);
+        d->flatPointsView = d->flatPoints.view();
+      }
+    }
+  });
 }
 
-QList<QPainterPath> SvgHelper::getSvgPathList() const {
-  return svgPathList;
+const QList<QList<QPointF>>& SvgDocument::getSvgPointList() const {
+  ensureInstances();
+  if (d->pointListPending) {
+    std::call_once(d->pointListOnce, [this] {
+      d->svgPointList.reserve(d->svgPathList.size());
+      QVector<QPair<int, int>> ranges;
+      QVector<bool> keep;
+      for (const QPainterPath& path : d->svgPathList) {
+        QList<QPointF> points;
+        flattenPainterPath(path, d->samplingPolicy, points);
+        if (d->simplifyTolerance > 0) {
+          simplifyPoints(points, d->simplifyTolerance, ranges, keep);
+        }
+        d->svgPointList.append(points);
+      }
+    });
+  }
+  return d->svgPointList;
 }
 
 #endif  // SVGHELPER_HPP